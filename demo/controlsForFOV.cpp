@@ -47,14 +47,37 @@ double offset = 0;
 double xpos, ypos;
 double currXpos, currYpos;
 
+// Set by input and window events, the first frame is always drawn
+bool redraw = true;
+
+void initControls(GLFWwindow* window) {
+	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetMouseButtonCallback(window, mouse_callback);
+	glfwSetCursorPosCallback(window, cursor_callback);
+	glfwSetKeyCallback(window, key_callback);
+	glfwSetWindowRefreshCallback(window, refresh_callback);
+}
+
+bool isInteracting() {
+	// offset is pending scroll input, consumed by computeMatricesFromInputs
+	return click || offset != 0;
+}
+
+void requestRedraw() {
+	redraw = true;
+}
+
+bool consumeRedraw() {
+	bool result = redraw;
+	redraw = false;
+	return result;
+}
+
 void computeMatricesFromInputs(
 	const int WIDTH, const int HEIGHT,
 	glm::vec3 &position, glm::vec3 & up,
 	glm::vec3 &rotx, glm::vec3 &roty
 ) {
-	glfwSetScrollCallback(window, scroll_callback);
-	glfwSetMouseButtonCallback(window, mouse_callback);
-
 	// Scroll
 	{
 		// Change position
@@ -134,7 +157,25 @@ void mouse_callback(GLFWwindow* window, int button, int action, int mods) {
 		xpos = NULL;
 		ypos = NULL;
 	}
+	redraw = true;
 }
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
 	offset = yoffset;
+	redraw = true;
+}
+void cursor_callback(GLFWwindow* window, double x, double y) {
+	// Only dragging changes the view
+	if (click) {
+		redraw = true;
+	}
+}
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+		glfwSetWindowShouldClose(window, GL_TRUE);
+	}
+	redraw = true;
+}
+void refresh_callback(GLFWwindow* window) {
+	// Window was exposed or resized, its contents are damaged
+	redraw = true;
 }
\ No newline at end of file
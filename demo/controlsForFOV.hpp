@@ -15,7 +15,21 @@ glm::vec3 getModelPosition();
 glm::vec3 getModelRotation();
 glm::vec3 getModelScaling();
 
+// Register the input and window callbacks (once, after window creation)
+void initControls(GLFWwindow* window);
+
+// True while the user drags or scrolls
+bool isInteracting();
+
+// Ask for a new frame, e.g. after the uploaded data changed
+void requestRedraw();
+// Returns true (and clears the request) if a new frame is needed
+bool consumeRedraw();
+
 void mouse_callback(GLFWwindow* window, int button, int action, int mods);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+void cursor_callback(GLFWwindow* window, double x, double y);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void refresh_callback(GLFWwindow* window);
 
 #endif // CONTROLSFORFOV_HPP
\ No newline at end of file
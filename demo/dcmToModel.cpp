@@ -1,13 +1,20 @@
 // Include standard liabraries
 #include <vector>
+#include <algorithm>
+#include <climits>
 
 // Dual mc builder
 #include "dualmc.h"
 #include "dualmc.hpp"
+#include "flyingEdges.hpp"
+#include "surfaceNets.hpp"
+#include "dualContouring.hpp"
+#include "weldVertices.hpp"
 
 // GLM
 #include "glm/glm.hpp"
 
+#include "getNormals.hpp"
 #include "dcmToModel.hpp"
 
 #include <time.h>
@@ -20,9 +27,7 @@ void dcmToModel::run(
 	const uint8_t iso,
 	std::vector<glm::vec3> & objVertices,
 	std::vector<unsigned int> & objFaces,
-	std::vector<int> & colors,
-	const int & rescale_intercept,
-	const unsigned short & rescale_slope
+	std::vector<uint8_t> & values
 ) {
 	// Set volume
 	Volume volume;
@@ -31,7 +36,7 @@ void dcmToModel::run(
 	volume.dimY = dimY;
 	volume.dimZ = dimZ;
 	volume.iso = iso;
-	volume.data.resize(dimX * dimY * dimZ);
+	volume.data.resize(size_t(dimX) * dimY * dimZ);
 	volume.data = raw;
 
 	// Array of vertices for the extracted surface
@@ -40,11 +45,9 @@ void dcmToModel::run(
 	// Array of quad indices for the extracted surface
 	std::vector<dualmc::Quad> quads;
 
-	// Array of colors for the extracted surface
-	std::vector<uint8_t> objColors;
-
-	// Compute surface
-	computeSurface(volume, vertices, quads, objColors);
+	// Compute surface, with the raw value of every vertex.
+	// Values are colored on the GPU by the transfer function.
+	computeSurface(volume, vertices, quads, values);
 
 	// TODO:
 	// Code below is a template way
@@ -70,21 +73,198 @@ void dcmToModel::run(
 		objFaces.push_back(face[1]);
 		objFaces.push_back(face[2]);
 
-		objFaces.push_back(face[0]);
-		objFaces.push_back(face[2]);
-		objFaces.push_back(face[3]);
+		// Triangles of dualContouring repeat their last corner
+		if (face[3] != face[2]) {
+			objFaces.push_back(face[0]);
+			objFaces.push_back(face[2]);
+			objFaces.push_back(face[3]);
+		}
+	}
+}
+
+void dcmToModel::runSlab(
+	const std::vector<uint8_t> & raw,
+	const unsigned int dimX,
+	const unsigned int dimY,
+	const unsigned int dimZ,
+	const uint8_t iso,
+	const unsigned int zBegin,
+	const unsigned int zEnd,
+	std::vector<glm::vec3> & objVertices,
+	std::vector<glm::vec3> & objNormals,
+	std::vector<unsigned int> & objFaces,
+	std::vector<uint8_t> & values
+) {
+	objVertices.clear();
+	objNormals.clear();
+	objFaces.clear();
+	values.clear();
+
+	// A vertex of a cell in slice z has faces from the edges in slices
+	// z and z + 1, so one slice of margin completes the border normals.
+	// The vertex of a dual contouring node has faces from the edges of
+	// all its cells.
+	int32_t margin = engine == ENGINE_DUAL_CONTOURING ? dualContouring::MAX_NODE_SIZE : 1;
+	int32_t marginBegin = std::max((int32_t)zBegin - margin, 0);
+	int32_t marginEnd = (int32_t)zEnd + margin;
+
+	std::vector<dualmc::Vertex> vertices;
+	std::vector<dualmc::Quad> quads;
+	std::vector<uint8_t> colors;
+	std::vector<size_t> sliceQuads;
+	if (engine == ENGINE_DUAL_CONTOURING) {
+		dualContouring builder;
+		builder.setMaxError(maxError);
+		builder.buildSlab(
+			&raw.front(),
+			dimX,
+			dimY,
+			dimZ,
+			iso,
+			marginBegin,
+			marginEnd,
+			vertices,
+			quads,
+			colors,
+			sliceQuads
+		);
+	}
+	else if (engine == ENGINE_SURFACE_NETS) {
+		surfaceNets builder;
+		builder.buildSlab(
+			&raw.front(),
+			dimX,
+			dimY,
+			dimZ,
+			iso,
+			marginBegin,
+			marginEnd,
+			vertices,
+			quads,
+			colors,
+			sliceQuads
+		);
+	}
+	else if (engine == ENGINE_FLYING_EDGES) {
+		flyingEdges builder;
+		builder.setQuadSoupMode(sharing != VERTICES_SHARED);
+		builder.setManifoldMode(manifold);
+		builder.buildSlab(
+			&raw.front(),
+			dimX,
+			dimY,
+			dimZ,
+			iso,
+			marginBegin,
+			marginEnd,
+			vertices,
+			quads,
+			colors,
+			sliceQuads
+		);
+	}
+	else {
+		dualmc builder;
+		builder.setOccupancyMode(true);
+		builder.setQuadSoupMode(sharing != VERTICES_SHARED);
+		builder.setManifoldMode(manifold);
+		builder.buildSlab(
+			&raw.front(),
+			dimX,
+			dimY,
+			dimZ,
+			iso,
+			marginBegin,
+			marginEnd,
+			vertices,
+			quads,
+			colors,
+			sliceQuads
+		);
+	}
+	checkIndexRange(vertices, quads, colors);
+	if (sharing == VERTICES_WELDED && engine != ENGINE_SURFACE_NETS && engine != ENGINE_DUAL_CONTOURING) {
+		weldVertices(vertices, quads, colors);
+	}
+
+	std::vector<glm::vec3> allVertices;
+	allVertices.reserve(vertices.size());
+	for (auto const & v : vertices) {
+		allVertices.push_back(glm::vec3(v.x, v.y, v.z));
 	}
+	// Faces of the quads, and the first face of every slice
+	std::vector<unsigned int> allFaces;
+	std::vector<size_t> sliceFaces(sliceQuads.size());
+	allFaces.reserve(quads.size() * 6);
+	size_t slice = 0;
+	for (size_t i = 0; i <= quads.size(); i++) {
+		for (; slice < sliceQuads.size() && sliceQuads[slice] == i; slice++) {
+			sliceFaces[slice] = allFaces.size();
+		}
+		if (i == quads.size()) {
+			break;
+		}
+		const dualmc::Quad & q = quads[i];
+		allFaces.push_back(q.i0);
+		allFaces.push_back(q.i1);
+		allFaces.push_back(q.i2);
+
+		// Triangles of dualContouring repeat their last corner
+		if (q.i3 != q.i2) {
+			allFaces.push_back(q.i0);
+			allFaces.push_back(q.i2);
+			allFaces.push_back(q.i3);
+		}
+	}
+	std::vector<glm::vec3> allNormals = getVertexNormals(allVertices, allFaces);
+
+	// Faces of the slab's own edges (sliceQuads covers the clamped range)
+	auto faceOffset = [&](const int32_t z) {
+		int32_t slice = std::min(std::max(z - marginBegin, 0), (int32_t)sliceFaces.size() - 1);
+		return sliceFaces[slice];
+	};
+	size_t firstFace = faceOffset((int32_t)zBegin);
+	size_t lastFace = faceOffset((int32_t)zEnd);
 
-	// Get colors (CT number)
-	for (auto color : objColors)
-	{
-		// Hu = pixel * slope + intercept
-		int newColor = color * rescale_slope + ((float)rescale_intercept/4096.0f * 255.0f);
-		//int newColor = color;
-		colors.push_back(newColor);
+	// Keep the vertices these quads use
+	std::vector<unsigned int> remap(allVertices.size(), UINT_MAX);
+	objFaces.reserve(lastFace - firstFace);
+	for (size_t i = firstFace; i < lastFace; i++) {
+		unsigned int index = allFaces[i];
+		if (remap[index] == UINT_MAX) {
+			remap[index] = (unsigned int)objVertices.size();
+			objVertices.push_back(allVertices[index]);
+			objNormals.push_back(allNormals[index]);
+			values.push_back(colors[index]);
+		}
+		objFaces.push_back(remap[index]);
 	}
 }
 
+void dcmToModel::checkIndexRange(
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors
+) const {
+	if (vertices.size() <= size_t(INT_MAX)) {
+		return;
+	}
+	printf("Surface of %zu vertices is too big for one extraction, extract it in slabs\n", vertices.size());
+	vertices.clear();
+	quads.clear();
+	colors.clear();
+}
+
+unsigned int dcmToModel::getSlicesAfter() const {
+	// Slice zEnd + 1 for the cells of the last edges, one more for the
+	// neighbours of manifold cells. Dual contouring reads the blocks of
+	// its margin and the gradient beyond them.
+	if (engine == ENGINE_DUAL_CONTOURING) {
+		return 2 * dualContouring::MAX_NODE_SIZE + 1;
+	}
+	return manifold ? 3 : 2;
+}
+
 void dcmToModel::computeSurface(
 	Volume & volume,
 	std::vector<dualmc::Vertex> & vertices,
@@ -92,16 +272,68 @@ void dcmToModel::computeSurface(
 	std::vector<uint8_t> & colors
 ) {
 	printf("%s" ,"Computing surface...\n");
-	dualmc builder;
-	builder.build(
-		&volume.data.front(),
-		volume.dimX,
-		volume.dimY,
-		volume.dimZ,
-		volume.iso,
-		vertices,
-		quads,
-		colors
-	);
+	if (engine == ENGINE_DUAL_CONTOURING) {
+		dualContouring builder;
+		builder.setMaxError(maxError);
+		builder.build(
+			&volume.data.front(),
+			volume.dimX,
+			volume.dimY,
+			volume.dimZ,
+			volume.iso,
+			vertices,
+			quads,
+			colors
+		);
+	}
+	else if (engine == ENGINE_SURFACE_NETS) {
+		surfaceNets builder;
+		builder.build(
+			&volume.data.front(),
+			volume.dimX,
+			volume.dimY,
+			volume.dimZ,
+			volume.iso,
+			vertices,
+			quads,
+			colors
+		);
+	}
+	else if (engine == ENGINE_FLYING_EDGES) {
+		flyingEdges builder;
+		builder.setQuadSoupMode(sharing != VERTICES_SHARED);
+		builder.setManifoldMode(manifold);
+		builder.build(
+			&volume.data.front(),
+			volume.dimX,
+			volume.dimY,
+			volume.dimZ,
+			volume.iso,
+			vertices,
+			quads,
+			colors
+		);
+	}
+	else {
+		dualmc builder;
+		// Only the bit data >= iso is needed to classify the cells
+		builder.setOccupancyMode(true);
+		builder.setQuadSoupMode(sharing != VERTICES_SHARED);
+		builder.setManifoldMode(manifold);
+		builder.build(
+			&volume.data.front(),
+			volume.dimX,
+			volume.dimY,
+			volume.dimZ,
+			volume.iso,
+			vertices,
+			quads,
+			colors
+		);
+	}
+	checkIndexRange(vertices, quads, colors);
+	if (sharing == VERTICES_WELDED && engine != ENGINE_SURFACE_NETS && engine != ENGINE_DUAL_CONTOURING) {
+		weldVertices(vertices, quads, colors);
+	}
 	printf("%s", "Computing surface done.\n");
 }
\ No newline at end of file
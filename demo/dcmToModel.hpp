@@ -3,8 +3,32 @@
 
 #include "dualmc.h"
 
+// Surface extraction engines, the first two give the same mesh.
+// Surface nets and dual contouring ignore the vertex sharing and manifold
+// options.
+enum ExtractionEngine {
+	ENGINE_DUALMC,		// dualmc, serial, vertices shared through a hash map
+	ENGINE_FLYING_EDGES,	// flyingEdges, parallel, exactly sized output
+	ENGINE_SURFACE_NETS,	// surfaceNets, serial, one vertex per cell, fastest
+	ENGINE_DUAL_CONTOURING	// dualContouring, serial, one vertex per octree node, fewest triangles
+};
+
+// Vertices of the extracted quads
+enum VertexSharing {
+	VERTICES_SHARED,	// shared by neighbouring quads
+	VERTICES_SOUP,		// four per quad, nothing to look up (previews)
+	VERTICES_WELDED		// quad soup, then shared by weldVertices
+};
+
 class dcmToModel {
 public:
+	void setEngine(const ExtractionEngine engine) { this->engine = engine; }
+	void setVertexSharing(const VertexSharing sharing) { this->sharing = sharing; }
+	// Manifold dual marching cubes, see dualmc::setManifoldMode
+	void setManifold(const bool manifold) { this->manifold = manifold; }
+	// Error bound of dual contouring, see dualContouring::setMaxError
+	void setMaxError(const float maxError) { this->maxError = maxError; }
+
 	void run(
 		const std::vector<uint8_t> raw,
 		const unsigned int &dimX,
@@ -13,11 +37,35 @@ public:
 		const uint8_t iso,
 		std::vector<glm::vec3> & objVertices,
 		std::vector<unsigned int> & objFaces,
-		std::vector<int> & colors,
-		const int & rescale_intercept,
-		const unsigned short & rescale_slope
+		std::vector<uint8_t> & values
+	);
+
+	// Mesh of the grid edges in slices [zBegin, zEnd) only, with vertex
+	// normals (see dualmc::buildSlab). The edges of one more slice on
+	// each side are extracted too, so the normals along the slab border
+	// are the ones of the whole mesh. Slabs of a volume together give the
+	// mesh of run, with the vertices on the borders duplicated.
+	// Only slices zBegin - 2 to zEnd + 1 of raw are read, one more on
+	// each side with setManifold. Dual contouring takes a margin of
+	// dualContouring::MAX_NODE_SIZE slices for the normals of its nodes
+	// and reads whole nodes, see getSlicesAfter.
+	void runSlab(
+		const std::vector<uint8_t> & raw,
+		const unsigned int dimX,
+		const unsigned int dimY,
+		const unsigned int dimZ,
+		const uint8_t iso,
+		const unsigned int zBegin,
+		const unsigned int zEnd,
+		std::vector<glm::vec3> & objVertices,
+		std::vector<glm::vec3> & objNormals,
+		std::vector<unsigned int> & objFaces,
+		std::vector<uint8_t> & values
 	);
 
+	// Slices from zEnd on that runSlab reads, with the current settings
+	unsigned int getSlicesAfter() const;
+
 	// Volume to save raw data
 	struct Volume {
 		int32_t dimX;
@@ -28,6 +76,22 @@ public:
 	};
 
 private:
+	ExtractionEngine engine = ENGINE_DUALMC;
+	VertexSharing sharing = VERTICES_SHARED;
+	bool manifold = false;
+	float maxError = 0.1f;
+
+	// Quads index the vertices of one extraction with int32_t, so a surface
+	// of more vertices is dropped with an error. A quad soup is checked
+	// before weldVertices, which relies on the same indices. Slabs index
+	// their own vertices and stay far below the limit (meshLoader), only
+	// the whole volume of very large studies can reach it.
+	void checkIndexRange(
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors
+	) const;
+
 	void computeSurface(
 		Volume & volume,
 		std::vector<dualmc::Vertex> & vertices,
@@ -0,0 +1,103 @@
+// Include standard liabraries
+#include <stdio.h>
+#include <string>
+
+// GLEW
+#include <GL/glew.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+#include "deferredShading.hpp"
+
+bool deferredShading::init(const int width, const int height, const char * defines) {
+	this->width = width;
+	this->height = height;
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	// Normal and tissue value, read back 1:1 with NEAREST
+	glGenTextures(1, &normalTissueTexture);
+	glBindTexture(GL_TEXTURE_2D, normalTissueTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, normalTissueTexture, 0);
+
+	// Depth is sampled to rebuild positions, so it is a texture here
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete) {
+		printf("G-buffer incomplete\n");
+		return false;
+	}
+
+	geometryProgramID = LoadShaders("GBuffer.vertexshader", NULL, "GBuffer.fragmentshader", defines);
+	geometryMatrixID = glGetUniformLocation(geometryProgramID, "MVP");
+	geometryViewMatrixID = glGetUniformLocation(geometryProgramID, "V");
+	geometryModelMatrixID = glGetUniformLocation(geometryProgramID, "M");
+
+	// fShader with its inputs read from the G-buffer
+	std::string lightingDefines = std::string(defines) + "#define DEFERRED\n";
+	lightingProgramID = LoadShaders("ScreenQuad.vertexshader", NULL, "fShader.fragmentshader", lightingDefines.c_str());
+	inverseMatrixID = glGetUniformLocation(lightingProgramID, "InverseMVP");
+	normalTissueID = glGetUniformLocation(lightingProgramID, "gNormalTissue");
+	depthID = glGetUniformLocation(lightingProgramID, "gDepth");
+	return true;
+}
+
+void deferredShading::beginGeometry(const glm::mat4 & MVP, const glm::mat4 & V, const glm::mat4 & M) {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glUseProgram(geometryProgramID);
+	glUniformMatrix4fv(geometryMatrixID, 1, GL_FALSE, &MVP[0][0]);
+	glUniformMatrix4fv(geometryViewMatrixID, 1, GL_FALSE, &V[0][0]);
+	glUniformMatrix4fv(geometryModelMatrixID, 1, GL_FALSE, &M[0][0]);
+}
+
+GLuint deferredShading::beginLighting(const glm::mat4 & MVP) {
+	glUseProgram(lightingProgramID);
+
+	glm::mat4 inverseMVP = glm::inverse(MVP);
+	glUniformMatrix4fv(inverseMatrixID, 1, GL_FALSE, &inverseMVP[0][0]);
+
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, normalTissueTexture);
+	glUniform1i(normalTissueID, 2);
+
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glUniform1i(depthID, 3);
+
+	return lightingProgramID;
+}
+
+void deferredShading::drawLighting() {
+	// One full-screen triangle, every pixel is shaded exactly once
+	glDisable(GL_DEPTH_TEST);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glEnable(GL_DEPTH_TEST);
+}
+
+void deferredShading::release() {
+	glDeleteProgram(lightingProgramID);
+	glDeleteProgram(geometryProgramID);
+	glDeleteTextures(1, &depthTexture);
+	glDeleteTextures(1, &normalTissueTexture);
+	glDeleteFramebuffers(1, &framebuffer);
+}
@@ -0,0 +1,50 @@
+#ifndef DEFERREDSHADING_HPP
+#define DEFERREDSHADING_HPP
+
+// Deferred shading.
+// The geometry pass writes a thin G-buffer (camera space normal,
+// tissue value, depth) with no lighting at all, the lighting pass then
+// runs fShader once per covered pixel. Overdraw of the dense mesh only
+// costs a G-buffer write, and lights only add work per pixel.
+class deferredShading {
+public:
+	// defines are passed on to the shaders (LIGHT_COUNT, ...).
+	// Returns false if the G-buffer is incomplete.
+	bool init(const int width, const int height, const char * defines);
+
+	// Bind and clear the G-buffer and its program; draw the mesh
+	// with the forward pass' vertex attributes after this
+	void beginGeometry(const glm::mat4 & MVP, const glm::mat4 & V, const glm::mat4 & M);
+
+	// Bind the lighting program with the G-buffer on texture units
+	// 2 and 3 and return it, so the caller can set the lighting
+	// uniforms shared with the forward program
+	GLuint beginLighting(const glm::mat4 & MVP);
+
+	// Shade every covered pixel into the bound framebuffer
+	void drawLighting();
+
+	GLuint getLightingProgram() const { return lightingProgramID; }
+
+	void release();
+
+private:
+	int width = 0;
+	int height = 0;
+
+	GLuint framebuffer = 0;
+	GLuint normalTissueTexture = 0;
+	GLuint depthTexture = 0;
+
+	GLuint geometryProgramID = 0;
+	GLuint geometryMatrixID = 0;
+	GLuint geometryViewMatrixID = 0;
+	GLuint geometryModelMatrixID = 0;
+
+	GLuint lightingProgramID = 0;
+	GLuint inverseMatrixID = 0;
+	GLuint normalTissueID = 0;
+	GLuint depthID = 0;
+};
+
+#endif // DEFERREDSHADING_HPP
@@ -1,6 +1,18 @@
+#define _CRT_SECURE_NO_WARNINGS
 // Include standard liabraries
 #include <vector>
-#include <filesystem>
+#include <string>
+#include <cstdint>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 // GLEW
 #define GLEW_STATIC
@@ -21,16 +33,27 @@ using namespace glm;
 
 // Include common
 #include "shader.hpp"
+#include "texture.hpp"
 //#include "controls.hpp"
 #include "controlsForFOV.hpp"
 #include "getNormals.hpp"
-#include "texture.hpp"
-#include "getUVs.hpp"
+#include "transferFunction.hpp"
+#include "taskScheduler.hpp"
+#include "frameCapture.hpp"
+#include "meshChunks.hpp"
+#include "qualityController.hpp"
+#include "postProcess.hpp"
+#include "deferredShading.hpp"
+#include "softwareRasterizer.hpp"
+#include "volumeRenderer.hpp"
+#include "mprSlicer.hpp"
 
 // Include dcmToModel
 #include "dependencies/include/converttobmp.h"
 #include "getImageData.hpp"
 #include "dcmToModel.hpp"
+#include "volumePyramid.hpp"
+#include "meshLoader.hpp"
 
 // Set window width and height
 const GLuint  WIDTH = 1024;
@@ -39,6 +62,125 @@ const char* PATH // DCM path
 	= "D:\\VS\\Project\\DJ_medical\\CT_img\\Recon_4";
 const uint8_t ISO = 204;	// Isosurface
 const uint8_t THRESHOLD = 225;	// Threshold
+const unsigned int CHUNK_GRID = 8;	// Mesh is split into CHUNK_GRID^3 cells for culling
+const unsigned int LOD_GRID = 128;	// Vertex clustering grid of the interaction LOD
+
+const GLsizei SHADOW_SIZE = 1024;	// Shadow map resolution
+
+// Point light with power in 255
+struct Light {
+	glm::vec3 position;
+	float power;
+};
+
+// Side lights and back light.
+// Every light gets a layer in the shadow map array, so adding one
+// only needs a new entry here.
+const float SIDE_Z = -11.0f;
+const Light LIGHTS[] = {
+	{ glm::vec3(SIDE_Z * sqrt(3.0f), 0.0f, SIDE_Z), 120.0f },
+	{ glm::vec3(-SIDE_Z * sqrt(3.0f), 0.0f, SIDE_Z), 100.0f },
+	{ glm::vec3(0.0f, 3.0f, 15.0f), 40.0f }
+};
+const int LIGHT_COUNT = sizeof(LIGHTS) / sizeof(LIGHTS[0]);
+
+// Shadow map cache.
+// The depth maps only have to be re-rendered when the mesh, a light
+// or the light-relative model transform changes.
+struct ShadowCache {
+	bool valid = false;
+	unsigned int meshVersion = 0;
+	std::vector<glm::vec3> lightPos;
+	glm::mat4 depthModelMatrix;
+
+	// Returns true (and stores the new state) if the maps are out of date
+	bool update(
+		const unsigned int meshVersion,
+		const std::vector<glm::vec3> & lightPos,
+		const glm::mat4 & depthModelMatrix
+	) {
+		if (valid
+			&& this->meshVersion == meshVersion
+			&& this->lightPos == lightPos
+			&& this->depthModelMatrix == depthModelMatrix) {
+			return false;
+		}
+		valid = true;
+		this->meshVersion = meshVersion;
+		this->lightPos = lightPos;
+		this->depthModelMatrix = depthModelMatrix;
+		return true;
+	}
+};
+
+// Uniforms shared by the forward program and the deferred lighting
+// program (both run fShader)
+struct LightingUniforms {
+	GLuint MatrixID;
+	GLuint ViewMatrixID;
+	GLuint ModelMatrixID;
+	GLuint DepthBiasID;
+	GLuint ShadowMapID;
+	GLuint LightID;
+	GLuint LightPowerID;
+	GLuint ShadowTapsID;
+	GLuint TransferFunctionID;
+
+	void init(const GLuint programID) {
+		// Get a handle for "MVP" uniform
+		MatrixID = glGetUniformLocation(programID, "MVP");
+		ViewMatrixID = glGetUniformLocation(programID, "V");
+		ModelMatrixID = glGetUniformLocation(programID, "M");
+
+		// Shadow map uniform
+		DepthBiasID = glGetUniformLocation(programID, "DepthBiasMVP");
+		ShadowMapID = glGetUniformLocation(programID, "shadowMap");
+
+		// Get a handle for "LightPosition" and "LightPower" uniform
+		LightID = glGetUniformLocation(programID, "LightPosition_worldspace");
+		LightPowerID = glGetUniformLocation(programID, "LightPower");
+		ShadowTapsID = glGetUniformLocation(programID, "ShadowTaps");
+
+		// Get a handle for "transferFunction" uniform
+		TransferFunctionID = glGetUniformLocation(programID, "transferFunction");
+	}
+
+	// Send this frame's state to the (bound) program
+	void send(
+		const glm::mat4 & MVP,
+		const glm::mat4 & ViewMatrix,
+		const glm::mat4 & ModelMatrix,
+		const std::vector<glm::mat4> & depthBiasMVP,
+		const std::vector<glm::vec3> & lightPos,
+		const std::vector<float> & lightPower,
+		const int shadowTaps,
+		const GLuint transferTexture,
+		const GLuint depthTexture
+	) const {
+		// Send transformation to the currently bound shader, 
+		// in the "MVP" uniform
+		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
+		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
+		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
+		// in the "Depth" uniform
+		glUniformMatrix4fv(DepthBiasID, (GLsizei)depthBiasMVP.size(), GL_FALSE, &depthBiasMVP[0][0][0]);
+		// in the "Light" uniform
+		glUniform3fv(LightID, (GLsizei)lightPos.size(), &lightPos[0].x);
+		glUniform1fv(LightPowerID, (GLsizei)lightPower.size(), &lightPower[0]);
+		glUniform1i(ShadowTapsID, shadowTaps);
+
+		// Bind the transfer function in Texture Unit 0
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_1D, transferTexture);
+		// Set our "transferFunction" sampler to use Texture Unit 0
+		glUniform1i(TransferFunctionID, 0);
+
+		// All lights' depth maps in Texture Unit 1
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+		glUniform1i(ShadowMapID, 1);
+	}
+};
 
 // MVP variables
 mat4 RotationMatrix = mat4(1);
@@ -47,22 +189,365 @@ glm::vec3 up = glm::vec3(0, 2, -15);
 glm::vec3 rotX = glm::vec3(1, 0, 0);
 glm::vec3 rotY = glm::vec3(0, 1, 0);
 
-// Convert dcm files to obj model
-void dcmFileToModel(
+// Who renders the images
+enum Renderer {
+	RENDERER_GL,		// OpenGL, interactive or headless
+	RENDERER_MESH_CPU,	// softwareRasterizer, headless only
+	RENDERER_VOLUME_CPU	// volumeRenderer on the raw volume, no mesh, headless only
+};
+
+// Program options
+struct AppOptions {
+	// Redraw every frame instead of on demand (for benchmarking)
+	bool continuousRendering;
+	// Frame time budget of the adaptive quality while interacting (ms)
+	double frameBudget;
+	// Anti-aliasing of the main pass
+	AntiAliasing antiAliasing;
+	// Samples per pixel of AA_MSAA
+	int samples;
+	// Shade each pixel once from a G-buffer instead of every fragment
+	bool deferred;
+	// Headless mode: render the camera poses of this file, no window
+	const char* posesPath;
+	// Directory of the headless images
+	const char* outputDir;
+	// Image size
+	int width;
+	int height;
+	// GLFW_CONTEXT_CREATION_API, OSMesa runs without display or GPU
+	int contextAPI;
+	// GL, or one of the CPU renderers, which need no GL at all
+	Renderer renderer;
+	// Ray casting mode of RENDERER_VOLUME_CPU
+	VolumeMode volumeMode;
+	// Show planes through the volume instead of the mesh
+	bool sliceViewer;
+	// Threads of the taskScheduler doing all CPU work, 0: one per core
+	unsigned int threads;
+	// Surface extraction of the mesh
+	ExtractionEngine engine;
+	// Vertices of the mesh quads
+	VertexSharing sharing;
+	// Manifold dual marching cubes
+	bool manifold;
+	// Error bound of dual contouring, in voxels
+	float maxError;
+	// Time the surface extraction of every engine instead of rendering
+	bool benchmark;
+};
+
+// Camera of one headless image, looking at the origin
+// like the interactive camera
+struct CameraPose {
+	glm::vec3 position;
+	glm::vec3 up;
+};
+
+// Read camera poses, one per line: position x y z, up x y z.
+// Empty lines and lines starting with # are skipped.
+bool loadCameraPoses(const char* path, std::vector<CameraPose> & poses) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		printf("%s could not be opened\n", path);
+		return false;
+	}
+	char line[256];
+	while (fgets(line, sizeof(line), file)) {
+		CameraPose pose;
+		if (line[0] == '#') {
+			continue;
+		}
+		int count = sscanf(line, "%f %f %f %f %f %f",
+			&pose.position.x, &pose.position.y, &pose.position.z,
+			&pose.up.x, &pose.up.y, &pose.up.z);
+		if (count == 6) {
+			poses.push_back(pose);
+		}
+		else if (count > 0) {
+			printf("Skipping camera pose: %s", line);
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+// Parse program arguments
+bool parseArgs(int argc, char* argv[], AppOptions & options) {
+	// set default options
+	options.continuousRendering = false;
+	options.frameBudget = 16.7;
+	options.antiAliasing = AA_FXAA;
+	options.samples = 16;
+	options.deferred = false;
+	options.posesPath = NULL;
+	options.outputDir = ".";
+	options.width = WIDTH;
+	options.height = HEIGHT;
+	options.contextAPI = GLFW_NATIVE_CONTEXT_API;
+	options.renderer = RENDERER_GL;
+	options.volumeMode = VOLUME_DVR;
+	options.sliceViewer = false;
+	options.threads = 0;
+	options.engine = ENGINE_DUALMC;
+	options.sharing = VERTICES_SHARED;
+	options.manifold = false;
+	options.maxError = 0.1f;
+	options.benchmark = false;
+
+	// parse arguments
+	for (int currentArg = 1; currentArg < argc; ++currentArg) {
+		if (strcmp(argv[currentArg], "-continuous") == 0) {
+			options.continuousRendering = true;
+		}
+		else if (strcmp(argv[currentArg], "-budget") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Frame budget missing\n");
+				return false;
+			}
+			options.frameBudget = atof(argv[currentArg + 1]);
+			++currentArg;
+		}
+		else if (strcmp(argv[currentArg], "-aa") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Anti-aliasing mode missing\n");
+				return false;
+			}
+			const char* mode = argv[currentArg + 1];
+			if (strcmp(mode, "none") == 0) {
+				options.antiAliasing = AA_NONE;
+			}
+			else if (strcmp(mode, "msaa") == 0) {
+				options.antiAliasing = AA_MSAA;
+			}
+			else if (strcmp(mode, "fxaa") == 0) {
+				options.antiAliasing = AA_FXAA;
+			}
+			else {
+				printf("Unknown anti-aliasing mode %s\n", mode);
+				return false;
+			}
+			++currentArg;
+		}
+		else if (strcmp(argv[currentArg], "-samples") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Sample count missing\n");
+				return false;
+			}
+			options.samples = atoi(argv[currentArg + 1]);
+			++currentArg;
+		}
+		else if (strcmp(argv[currentArg], "-deferred") == 0) {
+			options.deferred = true;
+		}
+		else if (strcmp(argv[currentArg], "-headless") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Camera pose file missing\n");
+				return false;
+			}
+			options.posesPath = argv[currentArg + 1];
+			++currentArg;
+		}
+		else if (strcmp(argv[currentArg], "-out") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Output directory missing\n");
+				return false;
+			}
+			options.outputDir = argv[currentArg + 1];
+			++currentArg;
+		}
+		else if (strcmp(argv[currentArg], "-size") == 0) {
+			if (currentArg + 2 >= argc) {
+				printf("Image size missing\n");
+				return false;
+			}
+			options.width = atoi(argv[currentArg + 1]);
+			options.height = atoi(argv[currentArg + 2]);
+			if (options.width <= 0 || options.height <= 0) {
+				printf("Invalid image size\n");
+				return false;
+			}
+			currentArg += 2;
+		}
+		else if (strcmp(argv[currentArg], "-context") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Context API missing\n");
+				return false;
+			}
+			const char* api = argv[currentArg + 1];
+			if (strcmp(api, "native") == 0) {
+				options.contextAPI = GLFW_NATIVE_CONTEXT_API;
+			}
+			else if (strcmp(api, "egl") == 0) {
+				options.contextAPI = GLFW_EGL_CONTEXT_API;
+			}
+			else if (strcmp(api, "osmesa") == 0) {
+				options.contextAPI = GLFW_OSMESA_CONTEXT_API;
+			}
+			else {
+				printf("Unknown context API %s\n", api);
+				return false;
+			}
+			++currentArg;
+		}
+		else if (strcmp(argv[currentArg], "-mpr") == 0) {
+			options.sliceViewer = true;
+		}
+		else if (strcmp(argv[currentArg], "-threads") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Thread count missing\n");
+				return false;
+			}
+			options.threads = (unsigned int)atoi(argv[currentArg + 1]);
+			++currentArg;
+		}
+		else if (strcmp(argv[currentArg], "-engine") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Engine missing\n");
+				return false;
+			}
+			const char* engine = argv[currentArg + 1];
+			if (strcmp(engine, "dualmc") == 0) {
+				options.engine = ENGINE_DUALMC;
+			}
+			else if (strcmp(engine, "flying") == 0) {
+				options.engine = ENGINE_FLYING_EDGES;
+			}
+			else if (strcmp(engine, "nets") == 0) {
+				options.engine = ENGINE_SURFACE_NETS;
+			}
+			else if (strcmp(engine, "adaptive") == 0) {
+				options.engine = ENGINE_DUAL_CONTOURING;
+			}
+			else {
+				printf("Unknown engine %s\n", engine);
+				return false;
+			}
+			++currentArg;
+		}
+		else if (strcmp(argv[currentArg], "-vertices") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Vertex sharing missing\n");
+				return false;
+			}
+			const char* sharing = argv[currentArg + 1];
+			if (strcmp(sharing, "shared") == 0) {
+				options.sharing = VERTICES_SHARED;
+			}
+			else if (strcmp(sharing, "soup") == 0) {
+				options.sharing = VERTICES_SOUP;
+			}
+			else if (strcmp(sharing, "welded") == 0) {
+				options.sharing = VERTICES_WELDED;
+			}
+			else {
+				printf("Unknown vertex sharing %s\n", sharing);
+				return false;
+			}
+			++currentArg;
+		}
+		else if (strcmp(argv[currentArg], "-manifold") == 0) {
+			options.manifold = true;
+		}
+		else if (strcmp(argv[currentArg], "-max-error") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Error bound missing\n");
+				return false;
+			}
+			options.maxError = (float)atof(argv[currentArg + 1]);
+			++currentArg;
+		}
+		else if (strcmp(argv[currentArg], "-benchmark") == 0) {
+			options.benchmark = true;
+		}
+		else if (strcmp(argv[currentArg], "-renderer") == 0) {
+			if (currentArg + 1 == argc) {
+				printf("Renderer missing\n");
+				return false;
+			}
+			const char* renderer = argv[currentArg + 1];
+			if (strcmp(renderer, "gl") == 0) {
+				options.renderer = RENDERER_GL;
+			}
+			else if (strcmp(renderer, "cpu") == 0) {
+				options.renderer = RENDERER_MESH_CPU;
+			}
+			else if (strcmp(renderer, "dvr") == 0) {
+				options.renderer = RENDERER_VOLUME_CPU;
+				options.volumeMode = VOLUME_DVR;
+			}
+			else if (strcmp(renderer, "mip") == 0) {
+				options.renderer = RENDERER_VOLUME_CPU;
+				options.volumeMode = VOLUME_MIP;
+			}
+			else if (strcmp(renderer, "iso") == 0) {
+				options.renderer = RENDERER_VOLUME_CPU;
+				options.volumeMode = VOLUME_ISO;
+			}
+			else {
+				printf("Unknown renderer %s\n", renderer);
+				return false;
+			}
+			++currentArg;
+		}
+		else {
+			printf("Unknown option %s\n", argv[currentArg]);
+			printf("Options:\n");
+			printf(" -continuous        redraw every frame and print frame times\n");
+			printf(" -budget <ms>       frame time budget while interacting (default 16.7)\n");
+			printf(" -aa <mode>         none, msaa or fxaa (default fxaa)\n");
+			printf(" -samples <n>       samples per pixel of -aa msaa (default 16)\n");
+			printf(" -deferred          deferred shading from a G-buffer\n");
+			printf(" -headless <file>   render the camera poses in file (x y z upX upY upZ per line)\n");
+			printf("                    to images, without a visible window\n");
+			printf(" -out <dir>         directory of the headless images (default .)\n");
+			printf(" -size <w> <h>      image size (default 1024 768)\n");
+			printf(" -context <api>     native, egl or osmesa (software, no display needed)\n");
+			printf(" -renderer <name>   gl, cpu (rasterized mesh, no shadows) or a ray cast of\n");
+			printf("                    the volume without meshing: dvr, mip or iso.\n");
+			printf("                    All but gl are headless only and multithreaded\n");
+			printf(" -mpr               axial, coronal, sagittal and oblique planes and slabs\n");
+			printf("                    through the volume instead of the mesh\n");
+			printf(" -threads <n>       threads for loading, meshing and the CPU renderers\n");
+			printf("                    (default one per core)\n");
+			printf(" -engine <name>     surface extraction: dualmc (default), flying (parallel\n");
+			printf("                    flying edges style, same mesh) or nets (surface nets,\n");
+			printf("                    one vertex per cell, fastest) or adaptive (octree dual\n");
+			printf("                    contouring, fewest triangles)\n");
+			printf(" -vertices <mode>   shared (default), soup (four per quad, faster, flat\n");
+			printf("                    shading) or welded (soup, then shared by position)\n");
+			printf(" -manifold          manifold dual marching cubes (Rephael Wenger)\n");
+			printf(" -max-error <v>     error bound of -engine adaptive in voxels (default 0.1)\n");
+			printf(" -benchmark         time the surface extraction of every engine and exit\n");
+			return false;
+		}
+	}
+	if (options.renderer != RENDERER_GL && options.posesPath == NULL) {
+		printf("CPU renderers need -headless\n");
+		return false;
+	}
+	if (options.sliceViewer && (options.posesPath != NULL || options.renderer != RENDERER_GL)) {
+		printf("-mpr is interactive only\n");
+		return false;
+	}
+	return true;
+}
+
+// Convert dcm files to a raw volume without noise
+void dcmFileToVolume(
 	const char* path,
-	const uint8_t iso,
 	const uint8_t threshold,
-	std::vector<glm::vec3> & objVertices,
-	std::vector<unsigned int> & objFaces,
-	std::vector<int> & colors,
+	std::vector<uint8_t> & raw,
+	unsigned int & dimX,
+	unsigned int & dimY,
+	unsigned int & dimZ,
 	int &rescale_intercept,
 	unsigned short &rescale_slope
 ) {
-	// Set x, y, z and raw data
-	unsigned int dimX = 0;
-	unsigned int dimY = 0;
-	unsigned int dimZ = 0;
-	std::vector<uint8_t> raw;
+	// Set x, y, z
+	dimX = 0;
+	dimY = 0;
+	dimZ = 0;
 	// Set parameter to convert Grayscale to CT number
 	rescale_intercept = 0;
 	rescale_slope = 0;
@@ -85,10 +570,37 @@ void dcmFileToModel(
 		threshold
 	);
 	printf("%s", "Get image done.\n");
+}
+
+// Convert dcm files to obj model
+void dcmFileToModel(
+	const char* path,
+	const uint8_t iso,
+	const uint8_t threshold,
+	const ExtractionEngine engine,
+	const VertexSharing sharing,
+	const bool manifold,
+	const float maxError,
+	std::vector<glm::vec3> & objVertices,
+	std::vector<unsigned int> & objFaces,
+	std::vector<uint8_t> & values,
+	int &rescale_intercept,
+	unsigned short &rescale_slope
+) {
+	// Set x, y, z and raw data
+	unsigned int dimX = 0;
+	unsigned int dimY = 0;
+	unsigned int dimZ = 0;
+	std::vector<uint8_t> raw;
+	dcmFileToVolume(path, threshold, raw, dimX, dimY, dimZ, rescale_intercept, rescale_slope);
 
 	// Convert raw file to obj model
 	// Use Marching Cubes Algorithm
 	dcmToModel dcm2Model;
+	dcm2Model.setEngine(engine);
+	dcm2Model.setVertexSharing(sharing);
+	dcm2Model.setManifold(manifold);
+	dcm2Model.setMaxError(maxError);
 	dcm2Model.run(
 		raw,
 		dimX,
@@ -97,29 +609,584 @@ void dcmFileToModel(
 		iso,
 		objVertices,
 		objFaces,
-		colors,
-		rescale_intercept,
-		rescale_slope
+		values
 	);
 }
 
+// Move the vertex centroid to the origin, the model rotates around it
+void centerVertices(std::vector<glm::vec3> & vertices) {
+	// Get pivot (Need change)
+	float pivot[3] = { 0.0f };
+	for (auto & vertex : vertices) {
+		// Add up
+		pivot[0] += vertex.x;
+		pivot[1] += vertex.y;
+		pivot[2] += vertex.z;
+	}
+	pivot[0] /= vertices.size();
+	pivot[1] /= vertices.size();
+	pivot[2] /= vertices.size();
+
+	for (auto & vertex : vertices) {
+		vertex.x -= pivot[0];
+		vertex.y -= pivot[1];
+		vertex.z -= pivot[2];
+	}
+}
+
+// Write image (moved out) to imagePath as a task of writes, so the
+// next pose is rendered meanwhile
+static void saveBMPTask(
+	taskGroup & writes,
+	const char * imagePath,
+	const int width,
+	const int height,
+	std::vector<unsigned char> & image
+) {
+	taskScheduler::global().run(writes, [path = std::string(imagePath), width, height, pixels = std::move(image)]() {
+		if (!saveBMP(path.c_str(), width, height, &pixels[0])) {
+			printf("%s could not be written\n", path.c_str());
+		}
+	});
+	image.clear();
+}
+
+// Headless mode on the CPU: same model, camera and lights as the GL
+// path, without shadows and anti-aliasing
+int renderPosesOnCPU(const AppOptions & options) {
+	clock_t start = clock();
+
+	std::vector<CameraPose> poses;
+	if (!loadCameraPoses(options.posesPath, poses)) {
+		return -1;
+	}
+
+	std::vector<glm::vec3> vertices;
+	std::vector<unsigned int> faces;
+	std::vector<uint8_t> values;
+	int rescale_intercept;
+	unsigned short rescale_slope;
+	dcmFileToModel(PATH, ISO, THRESHOLD, options.engine, options.sharing, options.manifold, options.maxError, vertices, faces, values, rescale_intercept, rescale_slope);
+	centerVertices(vertices);
+	std::vector<glm::vec3> normals = getVertexNormals(vertices, faces);
+
+	std::vector<unsigned char> transferRGB;
+	buildTransferFunction(TISSUE_CLASSES, TISSUE_CLASS_COUNT, rescale_intercept, rescale_slope, THRESHOLD, transferRGB);
+
+	std::vector<glm::vec3> lightPos(LIGHT_COUNT);
+	std::vector<float> lightPower(LIGHT_COUNT);
+	for (int i = 0; i < LIGHT_COUNT; i++) {
+		lightPos[i] = LIGHTS[i].position;
+		lightPower[i] = LIGHTS[i].power;
+	}
+
+	softwareRasterizer rasterizer;
+	rasterizer.init(options.width, options.height, 0);
+	rasterizer.setMesh(vertices, normals, values, faces);
+	rasterizer.setTransferFunction(transferRGB);
+	rasterizer.setLights(lightPos, lightPower);
+
+	printf("Start rendering\n");
+	printf("%f\n", (float)(clock() - start) / CLOCKS_PER_SEC);
+
+	// Same matrices as the GL headless mode
+	mat4 ProjectionMatrix = glm::perspective(glm::radians(45.0f), float(options.width) / float(options.height), 0.1f, 100.0f);
+	mat4 ModelMatrix = translate(mat4(1.0f), getModelPosition()) * RotationMatrix * scale(mat4(1.0f), getModelScaling());
+
+	std::vector<unsigned char> image;
+	taskGroup writes;
+	auto batchStart = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < poses.size(); i++) {
+		mat4 ViewMatrix = glm::lookAt(poses[i].position, glm::vec3(0, 0, 0), poses[i].up);
+		rasterizer.render(ProjectionMatrix, ViewMatrix, ModelMatrix, image);
+
+		char imagePath[1024];
+		snprintf(imagePath, sizeof(imagePath), "%s/pose_%05d.bmp", options.outputDir, (int)i);
+		saveBMPTask(writes, imagePath, options.width, options.height, image);
+	}
+	taskScheduler::global().wait(writes);
+	std::chrono::duration<double> batchTime = std::chrono::steady_clock::now() - batchStart;
+	printf("%d images in %f s\n", (int)poses.size(), batchTime.count());
+	return 0;
+}
+
+// Extract the surface of the volume with every engine a few times and
+// print the best time and the mesh size, with the -vertices, -manifold
+// and -max-error options
+int benchmarkEngines(const AppOptions & options) {
+	const int BENCHMARK_RUNS = 3;
+	const int ENGINES = 4;
+	const ExtractionEngine engines[ENGINES] = { ENGINE_DUALMC, ENGINE_FLYING_EDGES, ENGINE_SURFACE_NETS, ENGINE_DUAL_CONTOURING };
+	const char* engineNames[ENGINES] = { "dualmc", "flying", "nets", "adaptive" };
+
+	std::vector<uint8_t> raw;
+	unsigned int dimX, dimY, dimZ;
+	int rescale_intercept;
+	unsigned short rescale_slope;
+	dcmFileToVolume(PATH, THRESHOLD, raw, dimX, dimY, dimZ, rescale_intercept, rescale_slope);
+
+	double times[ENGINES];
+	size_t vertexCounts[ENGINES];
+	size_t faceCounts[ENGINES];
+	for (int engine = 0; engine < ENGINES; engine++) {
+		dcmToModel dcm2Model;
+		dcm2Model.setEngine(engines[engine]);
+		dcm2Model.setVertexSharing(options.sharing);
+		dcm2Model.setManifold(options.manifold);
+		dcm2Model.setMaxError(options.maxError);
+		for (int run = 0; run < BENCHMARK_RUNS; run++) {
+			std::vector<glm::vec3> vertices;
+			std::vector<unsigned int> faces;
+			std::vector<uint8_t> values;
+			auto runStart = std::chrono::steady_clock::now();
+			dcm2Model.run(raw, dimX, dimY, dimZ, ISO, vertices, faces, values);
+			std::chrono::duration<double, std::milli> runTime = std::chrono::steady_clock::now() - runStart;
+			if (run == 0 || runTime.count() < times[engine]) {
+				times[engine] = runTime.count();
+			}
+			vertexCounts[engine] = vertices.size();
+			faceCounts[engine] = faces.size() / 3;
+		}
+	}
+
+	printf("Surface extraction of %ux%ux%u voxels, best of %d:\n", dimX, dimY, dimZ, BENCHMARK_RUNS);
+	for (int engine = 0; engine < ENGINES; engine++) {
+		printf(" %-8s %10.1f ms %10zu vertices %10zu triangles\n",
+			engineNames[engine], times[engine], vertexCounts[engine], faceCounts[engine]);
+	}
+	return 0;
+}
+
+// Headless mode ray casting the volume: same camera and lights as the
+// GL path, the volume box is centered instead of the mesh
+int renderVolumeOnCPU(const AppOptions & options) {
+	clock_t start = clock();
+
+	std::vector<CameraPose> poses;
+	if (!loadCameraPoses(options.posesPath, poses)) {
+		return -1;
+	}
+
+	std::vector<uint8_t> raw;
+	unsigned int dimX, dimY, dimZ;
+	int rescale_intercept;
+	unsigned short rescale_slope;
+	dcmFileToVolume(PATH, THRESHOLD, raw, dimX, dimY, dimZ, rescale_intercept, rescale_slope);
+
+	// Tissue colors as on the mesh, opacity rising towards the isosurface
+	std::vector<unsigned char> transferRGB;
+	buildTransferFunction(TISSUE_CLASSES, TISSUE_CLASS_COUNT, rescale_intercept, rescale_slope, THRESHOLD, transferRGB);
+	std::vector<float> opacity;
+	buildOpacityFunction(ISO - 32, ISO + 16, 0.5f, opacity);
+
+	std::vector<glm::vec3> lightPos(LIGHT_COUNT);
+	std::vector<float> lightPower(LIGHT_COUNT);
+	for (int i = 0; i < LIGHT_COUNT; i++) {
+		lightPos[i] = LIGHTS[i].position;
+		lightPower[i] = LIGHTS[i].power;
+	}
+
+	volumeRenderer renderer;
+	renderer.init(options.width, options.height);
+	renderer.setVolume(raw, dimX, dimY, dimZ);
+	renderer.setTransferFunction(transferRGB, opacity);
+	renderer.setIso(ISO);
+	renderer.setLights(lightPos, lightPower);
+
+	printf("Start rendering\n");
+	printf("%f\n", (float)(clock() - start) / CLOCKS_PER_SEC);
+
+	mat4 ProjectionMatrix = glm::perspective(glm::radians(45.0f), float(options.width) / float(options.height), 0.1f, 100.0f);
+	glm::vec3 volumeCenter = glm::vec3(dimX - 1, dimY - 1, dimZ - 1) * 0.5f;
+	mat4 ModelMatrix = translate(mat4(1.0f), getModelPosition()) * RotationMatrix * scale(mat4(1.0f), getModelScaling())
+		* translate(mat4(1.0f), -volumeCenter);
+
+	std::vector<unsigned char> image;
+	taskGroup writes;
+	auto batchStart = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < poses.size(); i++) {
+		mat4 ViewMatrix = glm::lookAt(poses[i].position, glm::vec3(0, 0, 0), poses[i].up);
+		renderer.render(options.volumeMode, ProjectionMatrix, ViewMatrix, ModelMatrix, image);
+
+		char imagePath[1024];
+		snprintf(imagePath, sizeof(imagePath), "%s/pose_%05d.bmp", options.outputDir, (int)i);
+		saveBMPTask(writes, imagePath, options.width, options.height, image);
+	}
+	taskScheduler::global().wait(writes);
+	std::chrono::duration<double> batchTime = std::chrono::steady_clock::now() - batchStart;
+	printf("%d images in %f s\n", (int)poses.size(), batchTime.count());
+	return 0;
+}
+
+// Interactive multi-planar reconstruction of the volume, no mesh.
+// 1/2/3: axial, coronal or sagittal plane, left drag / page up / page
+// down: move the plane, right drag: tilt it (oblique), up / down: slab
+// thickness, M: slab mode (MIP, MinIP, average)
+int runSliceViewer(GLFWwindow* window, const AppOptions & options) {
+	std::vector<uint8_t> raw;
+	unsigned int dimX, dimY, dimZ;
+	int rescale_intercept;
+	unsigned short rescale_slope;
+	dcmFileToVolume(PATH, THRESHOLD, raw, dimX, dimY, dimZ, rescale_intercept, rescale_slope);
+
+	mprSlicer slicer;
+	slicer.init(options.width, options.height);
+	slicer.setVolume(raw, dimX, dimY, dimZ);
+
+	GLuint VertexArrayID;
+	glGenVertexArrays(1, &VertexArrayID);
+	glBindVertexArray(VertexArrayID);
+	GLuint programID = LoadShaders("ScreenQuad.vertexshader", "Slice.fragmentshader");
+	GLuint sliceTextureID = glGetUniformLocation(programID, "sliceTexture");
+
+	// Rows are tightly packed bytes
+	GLuint sliceTexture;
+	glGenTextures(1, &sliceTexture);
+	glBindTexture(GL_TEXTURE_2D, sliceTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, options.width, options.height, 0, GL_RED, GL_UNSIGNED_BYTE, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	const char* orientationNames[] = { "axial", "coronal", "sagittal" };
+	const char* slabNames[] = { "MIP", "MinIP", "average" };
+	const int keys[] = { GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_M, GLFW_KEY_UP, GLFW_KEY_DOWN };
+	const int KEY_COUNT = sizeof(keys) / sizeof(keys[0]);
+	bool keyDown[KEY_COUNT] = { false };
+
+	SliceOrientation orientation = SLICE_AXIAL;
+	bool oblique = false;
+	SlicePlane plane = slicer.getPlane(orientation);
+	float thickness = 1.0f;
+	SlabMode slabMode = SLAB_MIP;
+	glm::vec3 volumeMax(dimX - 1.0f, dimY - 1.0f, dimZ - 1.0f);
+	double lastX, lastY;
+	glfwGetCursorPos(window, &lastX, &lastY);
+
+	std::vector<unsigned char> image;
+	bool dirty = true;
+	while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0) {
+		// Keys act once per press
+		for (int i = 0; i < KEY_COUNT; i++) {
+			bool down = glfwGetKey(window, keys[i]) == GLFW_PRESS;
+			bool pressed = down && !keyDown[i];
+			keyDown[i] = down;
+			if (!pressed) {
+				continue;
+			}
+			if (i < 3) {
+				orientation = SliceOrientation(SLICE_AXIAL + i);
+				plane = slicer.getPlane(orientation);
+				oblique = false;
+			}
+			else if (keys[i] == GLFW_KEY_M) {
+				slabMode = SlabMode((slabMode + 1) % 3);
+			}
+			else if (keys[i] == GLFW_KEY_UP) {
+				thickness += 2.0f;
+			}
+			else if (thickness > 1.0f) {
+				thickness -= 2.0f;
+			}
+			dirty = true;
+		}
+
+		// Move along the normal, one voxel per step
+		glm::vec3 normal = glm::normalize(glm::cross(plane.axisU, plane.axisV));
+		if (glfwGetKey(window, GLFW_KEY_PAGE_UP) == GLFW_PRESS) {
+			plane.center += normal;
+			dirty = true;
+		}
+		if (glfwGetKey(window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS) {
+			plane.center -= normal;
+			dirty = true;
+		}
+
+		double x, y;
+		glfwGetCursorPos(window, &x, &y);
+		float dx = float(x - lastX);
+		float dy = float(y - lastY);
+		lastX = x;
+		lastY = y;
+		if (dx != 0.0f || dy != 0.0f) {
+			if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+				plane.center -= normal * (0.5f * dy);
+				dirty = true;
+			}
+			else if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
+				// Tilt around the in-plane axes
+				glm::quat tilt = glm::angleAxis(0.005f * dx, glm::normalize(plane.axisV))
+					* glm::angleAxis(0.005f * dy, glm::normalize(plane.axisU));
+				plane.axisU = tilt * plane.axisU;
+				plane.axisV = tilt * plane.axisV;
+				oblique = true;
+				dirty = true;
+			}
+		}
+		plane.center = glm::clamp(plane.center, glm::vec3(0.0f), volumeMax);
+
+		if (dirty) {
+			double sliceStart = glfwGetTime();
+			slicer.render(plane, thickness, slabMode, image);
+			double sliceMs = 1000.0 * (glfwGetTime() - sliceStart);
+			glBindTexture(GL_TEXTURE_2D, sliceTexture);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, options.width, options.height, GL_RED, GL_UNSIGNED_BYTE, &image[0]);
+			printf("%s, slab %.0f voxels %s, %.2f ms\n", oblique ? "oblique" : orientationNames[orientation],
+				thickness, slabNames[slabMode], sliceMs);
+
+			int framebufferWidth, framebufferHeight;
+			glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+			glViewport(0, 0, framebufferWidth, framebufferHeight);
+			glUseProgram(programID);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, sliceTexture);
+			glUniform1i(sliceTextureID, 0);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glfwSwapBuffers(window);
+			dirty = false;
+		}
+
+		// Sleep until input; held keys and drags keep sending events
+		glfwWaitEventsTimeout(0.05);
+	}
+
+	glDeleteTextures(1, &sliceTexture);
+	glDeleteProgram(programID);
+	glDeleteVertexArrays(1, &VertexArrayID);
+	return 0;
+}
+
+// Slab of the loader on the GPU (indexCount 0: not uploaded)
+struct PreviewPiece {
+	GLuint vertexbuffer = 0;
+	GLuint valuebuffer = 0;
+	GLuint normalbuffer = 0;
+	GLuint elementbuffer = 0;
+	GLsizei indexCount = 0;
+
+	void upload(const MeshPiece & piece) {
+		indexCount = (GLsizei)piece.faces.size();
+		glGenBuffers(1, &vertexbuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+		glBufferData(GL_ARRAY_BUFFER, piece.vertices.size() * sizeof(glm::vec3), piece.vertices.data(), GL_STATIC_DRAW);
+		glGenBuffers(1, &valuebuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, valuebuffer);
+		glBufferData(GL_ARRAY_BUFFER, piece.values.size() * sizeof(uint8_t), piece.values.data(), GL_STATIC_DRAW);
+		glGenBuffers(1, &normalbuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+		glBufferData(GL_ARRAY_BUFFER, piece.normals.size() * sizeof(glm::vec3), piece.normals.data(), GL_STATIC_DRAW);
+		glGenBuffers(1, &elementbuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, piece.faces.size() * sizeof(unsigned int), piece.faces.data(), GL_STATIC_DRAW);
+	}
+
+	// Attributes 0 to 2 have to be enabled
+	void draw() const {
+		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		glBindBuffer(GL_ARRAY_BUFFER, valuebuffer);
+		glVertexAttribPointer(1, 1, GL_UNSIGNED_BYTE, GL_FALSE, 0, (void*)0);
+		glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void*)0);
+	}
+
+	// Names are cleared, so releasing again does nothing (0 is ignored)
+	void release() {
+		glDeleteBuffers(1, &vertexbuffer);
+		glDeleteBuffers(1, &valuebuffer);
+		glDeleteBuffers(1, &normalbuffer);
+		glDeleteBuffers(1, &elementbuffer);
+		vertexbuffer = 0;
+		valuebuffer = 0;
+		normalbuffer = 0;
+		elementbuffer = 0;
+		indexCount = 0;
+	}
+};
+
+// Draw the loader's surface as it is extracted, with the interactive
+// camera and without shadows, until the mesh is complete: every slab
+// from the coarse preview until its full resolution piece is done.
+// The volume center is at the origin until the final mesh is centered
+// on its centroid. Returns false if ESC was pressed or the window
+// closed, which cancels loading.
+bool showLoadingProgress(
+	GLFWwindow* window,
+	meshLoader & loader,
+	const AppOptions & options,
+	const GLuint programID,
+	const LightingUniforms & uniforms,
+	const GLuint depthTexture
+) {
+	// Per slab
+	std::vector<PreviewPiece> coarsePieces;
+	std::vector<PreviewPiece> finePieces;
+	size_t uploadedPieces = 0;
+	GLuint transferTexture = 0;
+	glm::vec3 volumeCenter(0.0f);
+
+	std::vector<glm::vec3> lightPos(LIGHT_COUNT);
+	std::vector<float> lightPower(LIGHT_COUNT);
+	for (int i = 0; i < LIGHT_COUNT; i++) {
+		lightPos[i] = LIGHTS[i].position;
+		lightPower[i] = LIGHTS[i].power;
+	}
+	// Unused, no shadow taps
+	std::vector<glm::mat4> depthBiasMVP(LIGHT_COUNT, glm::mat4(1.0f));
+
+	bool completed = true;
+	LoadStage stage = loader.getStage();
+	LoadStage shownStage = LOAD_CANCELLED;
+	size_t shownPieces = SIZE_MAX;
+	while (stage != LOAD_DONE && stage != LOAD_CANCELLED) {
+		if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS || glfwWindowShouldClose(window)) {
+			loader.cancel();
+			completed = false;
+			break;
+		}
+
+		// Colors are known once the volume is decoded
+		unsigned int dims[3];
+		int rescale_intercept;
+		unsigned short rescale_slope;
+		if (transferTexture == 0 && loader.getVolumeInfo(dims, rescale_intercept, rescale_slope)) {
+			std::vector<unsigned char> transferRGB;
+			buildTransferFunction(TISSUE_CLASSES, TISSUE_CLASS_COUNT, rescale_intercept, rescale_slope, THRESHOLD, transferRGB);
+			transferTexture = createTransferFunctionTexture(transferRGB);
+			volumeCenter = 0.5f * glm::vec3(dims[0], dims[1], dims[2]);
+		}
+
+		// Upload the coarse surface once, then the slabs finished
+		// since the last frame
+		size_t slabCount = loader.getSlabCount();
+		if (finePieces.size() != slabCount) {
+			finePieces.resize(slabCount);
+		}
+		if (coarsePieces.empty() && loader.hasPreview()) {
+			coarsePieces.resize(slabCount);
+			for (size_t slab = 0; slab < slabCount; slab++) {
+				coarsePieces[slab].upload(loader.getPreviewPiece(slab));
+			}
+		}
+		size_t pieceCount = loader.getPieceCount();
+		for (; uploadedPieces < pieceCount; uploadedPieces++) {
+			size_t slab = loader.getPieceSlab(uploadedPieces);
+			finePieces[slab].upload(loader.getPiece(uploadedPieces));
+			// The coarse piece is not drawn any more
+			if (!coarsePieces.empty()) {
+				coarsePieces[slab].release();
+			}
+		}
+
+		// Progress in the title bar
+		if (stage != shownStage || pieceCount != shownPieces) {
+			// Slabs are extracted while the stages before still run
+			const char* stageNames[] = { "Reading images, ", "Removing noise, ", "" };
+			char title[128];
+			snprintf(title, sizeof(title), "demo - %sExtracting surface %d%%", stageNames[stage], (int)(100.0f * loader.getProgress()));
+			glfwSetWindowTitle(window, title);
+			shownStage = stage;
+			shownPieces = pieceCount;
+		}
+
+		computeMatricesFromInputs(options.width, options.height, position, up, rotX, rotY);
+		mat4 ProjectionMatrix = getProjectionMatrix();
+		mat4 ViewMatrix = getViewMatrix();
+		vec3 modelRotation = getModelRotation();
+		RotationMatrix = eulerAngleYXZ(modelRotation.y, modelRotation.x, modelRotation.z) * RotationMatrix;
+		mat4 ModelMatrix = translate(mat4(1.0f), getModelPosition()) * RotationMatrix
+			* scale(mat4(1.0f), getModelScaling()) * translate(mat4(1.0f), -volumeCenter);
+		mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, options.width, options.height);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (transferTexture != 0) {
+			glUseProgram(programID);
+			uniforms.send(MVP, ViewMatrix, ModelMatrix, depthBiasMVP,
+				lightPos, lightPower, 0, transferTexture, depthTexture);
+
+			glEnableVertexAttribArray(0);
+			glEnableVertexAttribArray(1);
+			glEnableVertexAttribArray(2);
+			for (size_t slab = 0; slab < finePieces.size(); slab++) {
+				if (finePieces[slab].indexCount > 0) {
+					finePieces[slab].draw();
+				}
+				else if (slab < coarsePieces.size() && coarsePieces[slab].indexCount > 0) {
+					coarsePieces[slab].draw();
+				}
+			}
+			glDisableVertexAttribArray(0);
+			glDisableVertexAttribArray(1);
+			glDisableVertexAttribArray(2);
+		}
+		glfwSwapBuffers(window);
+
+		// Wake up for input or the next slabs
+		glfwWaitEventsTimeout(0.1);
+		stage = loader.getStage();
+	}
+
+	for (auto & piece : coarsePieces) {
+		piece.release();
+	}
+	for (auto & piece : finePieces) {
+		piece.release();
+	}
+	glDeleteTextures(1, &transferTexture);
+	glfwSetWindowTitle(window, "demo");
+	return completed && stage == LOAD_DONE;
+}
+
 // MAIN function
 int main(int argc, char* argv[]) {
+	// Parse program options
+	AppOptions options;
+	if (!parseArgs(argc, argv, options)) {
+		return -1;
+	}
+	taskScheduler::setConcurrency(options.threads);
+	if (options.benchmark) {
+		return benchmarkEngines(options);
+	}
+	if (options.renderer == RENDERER_MESH_CPU) {
+		return renderPosesOnCPU(options);
+	}
+	if (options.renderer == RENDERER_VOLUME_CPU) {
+		return renderVolumeOnCPU(options);
+	}
+
+	// The G-buffer is single-sample, MSAA would only cover the lighting pass.
+	// Headless images are read from a single-sample target as well.
+	if ((options.deferred || options.posesPath != NULL) && options.antiAliasing == AA_MSAA) {
+		printf("MSAA is not supported with deferred shading or headless mode, using FXAA\n");
+		options.antiAliasing = AA_FXAA;
+	}
+
 	clock_t start, end;
 	start = clock();
 	// Init GLFW
 	glfwInit();
 	// Set all the required options for GLFW
-	glfwWindowHint(GLFW_SAMPLES, 16);
-	glEnable(GL_MULTISAMPLE);
+	// Only MSAA needs a multisampled window, FXAA resolves a single-sample target
+	glfwWindowHint(GLFW_SAMPLES, options.antiAliasing == AA_MSAA ? options.samples : 0);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy; should not be needed
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API, options.contextAPI);
+	// Headless mode only needs the context, images go to an offscreen target
+	bool headless = options.posesPath != NULL;
+	if (headless) {
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	}
 
 	// Create a GLFWwindow object that we can use for GLFW's functions
-	window = glfwCreateWindow(WIDTH, HEIGHT, "demo", nullptr, nullptr);
+	window = glfwCreateWindow(options.width, options.height, "demo", nullptr, nullptr);
 	if (window == NULL) {
 		fprintf(stderr, "Failed to open GLFW window\n");
 		getchar();
@@ -133,6 +1200,17 @@ int main(int argc, char* argv[]) {
 	glewInit();
 	// Ensure we can capture the escape key being pressed below
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
+	if (options.sliceViewer) {
+		int result = runSliceViewer(window, options);
+		glfwTerminate();
+		return result;
+	}
+	// Register input callbacks once, they also schedule redraws
+	initControls(window);
+	// Benchmarking wants frames as fast as possible
+	if (options.continuousRendering) {
+		glfwSwapInterval(0);
+	}
 
 	// Set background color
 	glClearColor(0.467f, 0.467f, 0.467f, 0.0f);
@@ -148,76 +1226,136 @@ int main(int argc, char* argv[]) {
 	glGenVertexArrays(1, &VertexArrayID);
 	glBindVertexArray(VertexArrayID);
 
-	// Create and compile our GLSL program from the shaders
-	GLuint depthProgramID = LoadShaders("DepthRTT.vertexshader", "DepthRTT.fragmentshader");
-	GLuint depthProgramID2 = LoadShaders("DepthRTT.vertexshader", "DepthRTT.fragmentshader");
-	GLuint depthProgramID3 = LoadShaders("DepthRTT.vertexshader", "DepthRTT.fragmentshader");
+	// Shaders size their light arrays with LIGHT_COUNT
+	char shaderDefines[128];
+	snprintf(shaderDefines, sizeof(shaderDefines), "#define LIGHT_COUNT %d\n#define LIGHT_VERTICES %d\n",
+		LIGHT_COUNT, 3 * LIGHT_COUNT);
+
+	// Create and compile our GLSL program from the shaders.
+	// The geometry shader renders every light's layer in one draw.
+	GLuint depthProgramID = LoadShaders(
+		"DepthRTT.vertexshader",
+		"DepthRTT.geometryshader",
+		"DepthRTT.fragmentshader",
+		shaderDefines
+	);
 
-	// Get a handle for our "MVP" uniform
+	// Get a handle for our "MVP" uniform (one matrix per light)
 	GLuint depthMatrixID = glGetUniformLocation(depthProgramID, "depthMVP");
-	GLuint depthMatrixID2 = glGetUniformLocation(depthProgramID2, "depthMVP");
-	GLuint depthMatrixID3 = glGetUniformLocation(depthProgramID3, "depthMVP");
 
-	// Load the texture
-	GLuint Texture;
+	// ----------------------------
+	// Render to Texture
+	// ----------------------------
+	// The framebuffer, which renders all lights into one layered texture.
+	GLuint FramebufferName = 0;
+	glGenFramebuffers(1, &FramebufferName);
+	glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName);
+
+	// Depth texture array, one layer per light.
+	// Slower than a depth buffer, but you can sample it later in your shader
+	GLuint depthTexture;
 	{
-		std::filesystem::path currPath = argv[0];
-		currPath = currPath.parent_path();
-		currPath += "\\img\\Texture.bmp";
-		char* path = currPath.string().data();
-		Texture = loadBMP(path);
+		glGenTextures(1, &depthTexture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT16, SHADOW_SIZE, SHADOW_SIZE, LIGHT_COUNT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
+
+		// Attach all layers, gl_Layer selects one in the geometry shader
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
 	}
 
-	// Set vertex, color and normal
+	// No color output in the bound framebuffer, only depth.
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	// Always check that our framebuffer is ok
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return false;
+
+	// Create and compile GLSL program from the shaders
+	GLuint programID = LoadShaders("vShader.vertexshader", NULL, "fShader.fragmentshader", shaderDefines);
+
+	LightingUniforms forwardUniforms;
+	forwardUniforms.init(programID);
+
+	// Set vertex, raw value and normal
 	std::vector<glm::vec3> vertices;
 	std::vector<unsigned int> faces;
-	std::vector<glm::vec2> uvs;
+	std::vector<uint8_t> values;
 	std::vector<glm::vec3> normals;
-	std::vector<int> colors;
 
-	// Get vertex via loading raw file
+	// Load the dcm files and build the mesh with vertex normals in the
+	// background, the window shows the surface as it is extracted
+	meshLoader loader;
+	loader.setEngine(options.engine);
+	loader.setVertexSharing(options.sharing);
+	loader.setManifold(options.manifold);
+	loader.setMaxError(options.maxError);
+	loader.start(PATH, ISO, THRESHOLD);
+	bool loaded;
+	if (headless) {
+		loader.wait();
+		loaded = loader.getStage() == LOAD_DONE;
+	}
+	else {
+		loaded = showLoadingProgress(window, loader, options, programID, forwardUniforms, depthTexture);
+	}
+	if (!loaded) {
+		// getImageData cannot be interrupted, finish it out of sight
+		printf("Loading cancelled\n");
+		glfwHideWindow(window);
+		loader.wait();
+		glDeleteProgram(programID);
+		glDeleteProgram(depthProgramID);
+		glDeleteFramebuffers(1, &FramebufferName);
+		glDeleteTextures(1, &depthTexture);
+		glDeleteVertexArrays(1, &VertexArrayID);
+		glfwTerminate();
+		return 0;
+	}
+	unsigned int volumeDims[3];
 	int rescale_intercept;
 	unsigned short rescale_slope;
-	dcmFileToModel(PATH, ISO, THRESHOLD, vertices, faces, colors, rescale_intercept, rescale_slope);
-
-	// Get pivot (Need change)
-	{
-		float pivot[3] = { 0.0f };
-		for (auto & vertex : vertices) {
-			// Add up
-			pivot[0] += vertex.x;
-			pivot[1] += vertex.y;
-			pivot[2] += vertex.z;
-		}
-		pivot[0] /= vertices.size();
-		pivot[1] /= vertices.size();
-		pivot[2] /= vertices.size();
-
-		for (auto & vertex : vertices) {
-			vertex.x -= pivot[0];
-			vertex.y -= pivot[1];
-			vertex.z -= pivot[2];
-		}
-	}
-
-	// Get normal
-	// Surface normal vector
-	//normals = getNormals(vertices);
-	// Vertex normal vector
-	normals = getVertexNormals(vertices, faces);
-
-	int uvThreshold = THRESHOLD * rescale_slope + ((float)rescale_intercept / 4096.0f * 255.0f);
-	getUVs(vertices, colors, uvs, uvThreshold);
+	loader.getVolumeInfo(volumeDims, rescale_intercept, rescale_slope);
+	loader.takeMesh(vertices, normals, values, faces);
+
+	// Center the model
+	centerVertices(vertices);
+
+	// Tissue colors of all raw values, from the classification table.
+	// Recoloring only rebuilds these 256 entries.
+	std::vector<unsigned char> transferRGB;
+	buildTransferFunction(TISSUE_CLASSES, TISSUE_CLASS_COUNT, rescale_intercept, rescale_slope, THRESHOLD, transferRGB);
+	GLuint transferTexture = createTransferFunctionTexture(transferRGB);
+
+	// Split faces into spatial chunks for per-pass frustum culling
+	// (reorders faces, so it has to run before the upload)
+	std::vector<MeshChunk> chunks;
+	buildMeshChunks(vertices, faces, chunks, CHUNK_GRID);
+	printf("Mesh split into %d chunks\n", (int)chunks.size());
+
+	// Coarse index buffer over the same vertices, drawn while interacting
+	std::vector<unsigned int> lodFaces;
+	buildClusteredLOD(vertices, faces, LOD_GRID, lodFaces);
+	std::vector<MeshChunk> lodChunks;
+	buildMeshChunks(vertices, lodFaces, lodChunks, CHUNK_GRID);
+	printf("Interaction LOD: %d of %d triangles\n", (int)lodFaces.size() / 3, (int)faces.size() / 3);
 
 	GLuint vertexbuffer;
 	glGenBuffers(1, &vertexbuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
 
-	GLuint uvbuffer;
-	glGenBuffers(1, &uvbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-	glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
+	// One byte per vertex
+	GLuint valuebuffer;
+	glGenBuffers(1, &valuebuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, valuebuffer);
+	glBufferData(GL_ARRAY_BUFFER, values.size() * sizeof(uint8_t), &values[0], GL_STATIC_DRAW);
 
 	GLuint normalbuffer;
 	glGenBuffers(1, &normalbuffer);
@@ -230,283 +1368,135 @@ int main(int argc, char* argv[]) {
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(unsigned int), &faces[0], GL_STATIC_DRAW);
 
-	// ----------------------------
-	// Render to Texture
-	// ----------------------------
-	// The framebuffer, which regroups 3 textures.
-	GLuint FramebufferName = 0;
-	glGenFramebuffers(1, &FramebufferName);
-	glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName);
-
-	// Depth texture. Slower than a depth buffer, but you can sample it later in your shader
-	GLuint depthTexture;
-	{
-		glGenTextures(1, &depthTexture);
-		glBindTexture(GL_TEXTURE_2D, depthTexture);
+	GLuint lodElementbuffer;
+	glGenBuffers(1, &lodElementbuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lodElementbuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, lodFaces.size() * sizeof(unsigned int), lodFaces.data(), GL_STATIC_DRAW);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, 1024, 1024, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
 
-		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+	// G-buffer and lighting pass of deferred mode
+	deferredShading deferred;
+	LightingUniforms deferredUniforms;
+	if (options.deferred) {
+		if (deferred.init(options.width, options.height, shaderDefines)) {
+			deferredUniforms.init(deferred.getLightingProgram());
+		}
+		else {
+			options.deferred = false;
+		}
 	}
 
-	GLuint FramebufferName2 = 0;
-	glGenFramebuffers(1, &FramebufferName2);
-	glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName2);
-	GLuint depthTexture2;
-	{
-		glGenTextures(1, &depthTexture2);
-		glBindTexture(GL_TEXTURE_2D, depthTexture2);
-
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, 1024, 1024, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
+	// Culled draws: layered shadow pass + camera pass
+	chunkDrawer drawer;
+	drawer.init(chunks, 2);
+	chunkDrawer lodDrawer;
+	lodDrawer.init(lodChunks, 1);
 
-		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture2, 0);
+	// Offscreen target of the FXAA resolve
+	postProcess post;
+	if (options.antiAliasing == AA_FXAA && !post.init(options.width, options.height)) {
+		options.antiAliasing = AA_NONE;
 	}
 
-	GLuint FramebufferName3 = 0;
-	glGenFramebuffers(1, &FramebufferName3);
-	glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName3);
-	GLuint depthTexture3;
-	{
-		glGenTextures(1, &depthTexture3);
-		glBindTexture(GL_TEXTURE_2D, depthTexture3);
-
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, 1024, 1024, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
-
-		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture3, 0);
-	}
-
-
-	// No color output in the bound framebuffer, only depth.
-	glDrawBuffer(GL_NONE);
-
-	// Always check that our framebuffer is ok
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return false;
-
-	// Create and compile GLSL program from the shaders
-	GLuint programID = LoadShaders("vShader.vertexshader", "fShader.fragmentshader");
-
-	// Get a handle for "textureSampler" uniform
-	GLuint TextureID = glGetUniformLocation(programID, "textureSampler");
-
-	// Get a handle for "MVP" uniform
-	GLuint MatrixID = glGetUniformLocation(programID, "MVP");
-	GLuint ViewMatrixID = glGetUniformLocation(programID, "V");
-	GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
-
-	// Shadow map uniform
-	GLuint DepthBiasID = glGetUniformLocation(programID, "DepthBiasMVP");
-	GLuint ShadowMapID = glGetUniformLocation(programID, "shadowMap");
-	GLuint DepthBiasID2 = glGetUniformLocation(programID, "DepthBiasMVP2");
-	GLuint ShadowMapID2 = glGetUniformLocation(programID, "shadowMap2");
-	GLuint DepthBiasID3 = glGetUniformLocation(programID, "DepthBiasMVP3");
-	GLuint ShadowMapID3 = glGetUniformLocation(programID, "shadowMap3");
-
-	// Get a handle for "LightPosition" uniform
-	GLuint LightID = glGetUniformLocation(programID, "LightPosition_worldspace");
-	GLuint LightID2 = glGetUniformLocation(programID, "LightPosition_worldspace2");
-	GLuint LightID3 = glGetUniformLocation(programID, "LightPosition_worldspace3");
-
-	printf("Start rendering\n");
-	end = clock();
-	printf("%f\n", (float)(end - start) / CLOCKS_PER_SEC);
-
-	// Start rendering
-	do {
-		// Set light postion for 3 three buffer render
-		// Side light
-		float sideZ = -11.0f;
-		float sideX = sideZ * sqrt(3.0f);
-		glm::vec3 lightPos = vec3(sideX, 0.0f, sideZ);
-		glm::vec3 lightPos2 = vec3(-sideX, 0.0f, sideZ);
-		// Back light
-		glm::vec3 lightPos3 = vec3(0.0f, 3.0f, 15.0f);
-
-		// Render to our framebuffer
-
-		// ----------------------------
-		// First light
-		// ----------------------------
-		glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName);
-		glViewport(0, 0, 1024, 1024); // Render on the whole framebuffer, complete from the lower left corner to the upper right
-
-		// We don't use bias in the shader, but instead we draw back faces, 
-		// which are already separated from the front faces by a small distance 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-
+	// Where the lit scene goes: the FXAA target or the output
+	// (the window, or the capture target in headless mode)
+	auto bindSceneTarget = [&](const GLuint outputFramebuffer) {
+		if (options.antiAliasing == AA_FXAA) {
+			post.begin();
+		}
+		else {
+			glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+			glViewport(0, 0, options.width, options.height); // Render on the whole framebuffer, complete from the lower left corner to the upper right
+		}
 		// Clear the screen
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	};
+
+	// Cheap frames while dragging, full quality at rest
+	qualityController quality;
+	quality.init(options.frameBudget);
+
+	// Bumped whenever the uploaded mesh changes, invalidating the shadow maps
+	unsigned int meshVersion = 1;
+	ShadowCache shadowCache;
+
+	// Shadow maps (if out of date) and the lit scene, into
+	// outputFramebuffer (0 is the window)
+	auto renderFrame = [&](
+		const glm::mat4 & ProjectionMatrix,
+		const glm::mat4 & ViewMatrix,
+		const glm::mat4 & ModelMatrix,
+		const QualitySettings & settings,
+		const GLuint outputFramebuffer
+	) {
+		drawer.beginFrame();
+		lodDrawer.beginFrame();
+
+		// Light positions and powers
+		std::vector<glm::vec3> lightPos(LIGHT_COUNT);
+		std::vector<float> lightPower(LIGHT_COUNT);
+		for (int i = 0; i < LIGHT_COUNT; i++) {
+			lightPos[i] = LIGHTS[i].position;
+			lightPower[i] = LIGHTS[i].power;
+		}
 
-		// Use our shader
-		glUseProgram(depthProgramID);
-
+		// Depth matrices, also needed by the main pass
 		glm::mat4 depthProjectionMatrix = glm::ortho<float>(-20, 20, -20, 20, -20, 20);
-		glm::mat4 depthViewMatrix = glm::lookAt(lightPos, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 		glm::mat4 depthModelMatrix = glm::mat4(1.0f);
-		glm::mat4 depthMVP = depthProjectionMatrix * depthViewMatrix * depthModelMatrix;
-		// Send our transformation to the currently bound shader, 
-		// in the "MVP" uniform
-		glUniformMatrix4fv(depthMatrixID, 1, GL_FALSE, &depthMVP[0][0]);
-
-		// 1rst attribute buffer : vertices
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-		glVertexAttribPointer(
-			0,								 // The attribute we want to configure
-			3,								 // size
-			GL_FLOAT,			     // type
-			GL_FALSE,			     // normalized?
-			0,							     // stride
-			(void*)0					 // array buffer offset
-		);
-
-		// Index buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-
-		// Draw the triangles !
-		glDrawElements(
-			GL_TRIANGLES,		// mode
-			faces.size(),					// count
-			GL_UNSIGNED_INT,	// type
-			(void*)0						// element array buffer offset
-		);
-
-		glDisableVertexAttribArray(0);
-
-		// ----------------------------------------------
-		// Second light (only light changes)
-		// ----------------------------------------------
-
-		glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName2);
-		glViewport(0, 0, 1024, 1024);
-
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		glUseProgram(depthProgramID2);
-
-		depthProjectionMatrix = glm::ortho<float>(-20, 20, -20, 20, -20, 20);
-		depthViewMatrix = glm::lookAt(lightPos2, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-		depthModelMatrix = glm::mat4(1.0f);
-		glm::mat4 depthMVP2 = depthProjectionMatrix * depthViewMatrix * depthModelMatrix;
-
-		glUniformMatrix4fv(depthMatrixID2, 1, GL_FALSE, &depthMVP2[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-		glVertexAttribPointer(
-			0,
-			3,
-			GL_FLOAT,
-			GL_FALSE,
-			0,
-			(void*)0
-		);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-
-		glDrawElements(
-			GL_TRIANGLES,
-			faces.size(),
-			GL_UNSIGNED_INT,
-			(void*)0
-		);
-
-		glDisableVertexAttribArray(0);
-
-		// -----------------------------------------------------------
-		// Third light (back light, only light changes)
-		// -----------------------------------------------------------
-
-		glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName2);
-		glViewport(0, 0, 1024, 1024);
-
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		glUseProgram(depthProgramID2);
-
-		depthProjectionMatrix = glm::ortho<float>(-20, 20, -20, 20, -20, 20);
-		depthViewMatrix = glm::lookAt(lightPos3, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-		depthModelMatrix = glm::mat4(1.0f);
-		glm::mat4 depthMVP3 = depthProjectionMatrix * depthViewMatrix * depthModelMatrix;
-
-		glUniformMatrix4fv(depthMatrixID3, 1, GL_FALSE, &depthMVP3[0][0]);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-		glVertexAttribPointer(
-			0,
-			3,
-			GL_FLOAT,
-			GL_FALSE,
-			0,
-			(void*)0
-		);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-
-		glDrawElements(
-			GL_TRIANGLES,
-			faces.size(),
-			GL_UNSIGNED_INT,
-			(void*)0
-		);
+		std::vector<glm::mat4> depthMVP(LIGHT_COUNT);
+		for (int i = 0; i < LIGHT_COUNT; i++) {
+			glm::mat4 depthViewMatrix = glm::lookAt(lightPos[i], glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+			depthMVP[i] = depthProjectionMatrix * depthViewMatrix * depthModelMatrix;
+		}
 
-		glDisableVertexAttribArray(0);
+		// ----------------------------
+		// All lights, if out of date
+		// ----------------------------
+		if (shadowCache.update(meshVersion, lightPos, depthModelMatrix)) {
+			// Render to our framebuffer
+			glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName);
+			glViewport(0, 0, SHADOW_SIZE, SHADOW_SIZE); // Render on the whole framebuffer, complete from the lower left corner to the upper right
+
+			// We don't use bias in the shader, but instead we draw back faces, 
+			// which are already separated from the front faces by a small distance 
+			glEnable(GL_CULL_FACE);
+			glCullFace(GL_BACK);
+
+			// Clear every layer
+			glClear(GL_DEPTH_BUFFER_BIT);
+
+			// Use our shader
+			glUseProgram(depthProgramID);
+
+			// Send our transformation to the currently bound shader, 
+			// in the "MVP" uniform
+			glUniformMatrix4fv(depthMatrixID, LIGHT_COUNT, GL_FALSE, &depthMVP[0][0][0]);
+
+			// 1rst attribute buffer : vertices
+			glEnableVertexAttribArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+			glVertexAttribPointer(
+				0,								 // The attribute we want to configure
+				3,								 // size
+				GL_FLOAT,			     // type
+				GL_FALSE,			     // normalized?
+				0,							     // stride
+				(void*)0					 // array buffer offset
+			);
+
+			// Index buffer
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+
+			// Draw the chunks inside any light frustum, once for all layers
+			drawer.draw(0, &depthMVP[0], LIGHT_COUNT);
+
+			glDisableVertexAttribArray(0);
+		}
 
 		// ----------------------------
 		// Render to the screen
 		// ----------------------------
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glViewport(0, 0, WIDTH, HEIGHT); // Render on the whole framebuffer, complete from the lower left corner to the upper right
-
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-
-		// Clear the screen
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// Use shader
-		glUseProgram(programID);
-
-		// Build MVP Matrix
-		// ProjectionMatrix & ViewMatrix
-		computeMatricesFromInputs(WIDTH, HEIGHT, position, up, rotX, rotY);
-		mat4 ProjectionMatrix = getProjectionMatrix();
-		mat4 ViewMatrix = getViewMatrix();
-
-		// ModelMatrix
-		vec3 modelRotation = getModelRotation();
-		// Quaternion is better than Euler Angle
-		RotationMatrix = eulerAngleYXZ(modelRotation.y, modelRotation.x, modelRotation.z) * RotationMatrix;
-		mat4 TranslationMatrix = translate(mat4(1.0f), getModelPosition());
-		mat4 ScalingMatrix = scale(mat4(1.0f), getModelScaling());
-		mat4 ModelMatrix = TranslationMatrix * RotationMatrix * ScalingMatrix;
-
 		glm::mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
 
 		// Get depth matrix
@@ -516,44 +1506,36 @@ int main(int argc, char* argv[]) {
 			0.0, 0.0, 0.5, 0.0,
 			0.5, 0.5, 0.5, 1.0
 		);
-		glm::mat4 depthBiasMVP = biasMatrix * depthMVP;
-		glm::mat4 depthBiasMVP2 = biasMatrix * depthMVP2;
-		glm::mat4 depthBiasMVP3 = biasMatrix * depthMVP3;
-
-		// Send transformation to the currently bound shader, 
-		// in the "MVP" uniform
-		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-		// in the "Depth" uniform
-		glUniformMatrix4fv(DepthBiasID, 1, GL_FALSE, &depthBiasMVP[0][0]);
-		glUniformMatrix4fv(DepthBiasID2, 1, GL_FALSE, &depthBiasMVP2[0][0]);
-		glUniformMatrix4fv(DepthBiasID3, 1, GL_FALSE, &depthBiasMVP3[0][0]);
-		// in the "Light" uniform
-		glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
-		glUniform3f(LightID2, lightPos2.x, lightPos2.y, lightPos2.z);
-		glUniform3f(LightID3, lightPos3.x, lightPos3.y, lightPos3.z);
-
-		// Bind our texture in Texture Unit 0
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, Texture);
-		// Set our "textureSampler" sampler to use Texture Unit 0
-		glUniform1i(TextureID, 0);
-
-		// First light
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, depthTexture);
-		glUniform1i(ShadowMapID, 1);
+		std::vector<glm::mat4> depthBiasMVP(LIGHT_COUNT);
+		for (int i = 0; i < LIGHT_COUNT; i++) {
+			depthBiasMVP[i] = biasMatrix * depthMVP[i];
+		}
 
-		// Second light
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, depthTexture2);
-		glUniform1i(ShadowMapID2, 2);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_BACK);
 
-		// Third light
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, depthTexture3);
-		glUniform1i(ShadowMapID2, 3);
+		// Deferred: the mesh only fills the G-buffer, it is lit below
+		if (options.deferred) {
+			deferred.beginGeometry(MVP, ViewMatrix, ModelMatrix);
+		}
+		else {
+			bindSceneTarget(outputFramebuffer);
+
+			// Reduced sampling while interacting
+			if (options.antiAliasing == AA_MSAA) {
+				if (settings.antialias) {
+					glEnable(GL_MULTISAMPLE);
+				}
+				else {
+					glDisable(GL_MULTISAMPLE);
+				}
+			}
+
+			// Use shader
+			glUseProgram(programID);
+			forwardUniforms.send(MVP, ViewMatrix, ModelMatrix, depthBiasMVP,
+				lightPos, lightPower, settings.shadowTaps, transferTexture, depthTexture);
+		}
 
 		// 1rst attribute buffer : Vertices
 		glEnableVertexAttribArray(0);
@@ -567,13 +1549,13 @@ int main(int argc, char* argv[]) {
 			(void*)0						// array buffer offset
 		);
 
-		// 2nd attribute buffer : UVs
+		// 2nd attribute buffer : raw values
 		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, valuebuffer);
 		glVertexAttribPointer(
 			1,									// attribute. No particular reason for 1, but must match the layout in the shader.
-			2,									// size : U+V => 2
-			GL_FLOAT,					// type
+			1,									// size
+			GL_UNSIGNED_BYTE,			// type, read as 0-255 floats
 			GL_FALSE,					// normalized?
 			0,									// stride
 			(void*)0						// array buffer offset
@@ -591,47 +1573,156 @@ int main(int argc, char* argv[]) {
 			(void*)0						// array buffer offset
 		);
 
-		// Index buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-
-		glDrawElements(
-			GL_TRIANGLES,		// mode
-			faces.size(),					// count
-			GL_UNSIGNED_INT,	// type
-			(void*)0						// element array buffer offset
-		);
+		// Draw the chunks inside the view frustum, coarse while interacting
+		if (settings.coarseMesh) {
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lodElementbuffer);
+			lodDrawer.draw(0, MVP);
+		}
+		else {
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+			drawer.draw(1, MVP);
+		}
 
 		glDisableVertexAttribArray(0);
 		glDisableVertexAttribArray(1);
 		glDisableVertexAttribArray(2);
 
-		// Swap buffers
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		// Light every covered pixel once
+		if (options.deferred) {
+			bindSceneTarget(outputFramebuffer);
+			deferred.beginLighting(MVP);
+			deferredUniforms.send(MVP, ViewMatrix, ModelMatrix, depthBiasMVP,
+				lightPos, lightPower, settings.shadowTaps, transferTexture, depthTexture);
+			deferred.drawLighting();
+		}
 
-	} // Check if the ESC key was pressed or the window was closed
-	while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
-		glfwWindowShouldClose(window) == 0);
+		// Full-screen FXAA pass, or a plain copy while interacting
+		if (options.antiAliasing == AA_FXAA) {
+			post.resolve(settings.antialias, outputFramebuffer);
+		}
+
+		drawer.endFrame();
+		lodDrawer.endFrame();
+	};
+
+	printf("Start rendering\n");
+	end = clock();
+	printf("%f\n", (float)(end - start) / CLOCKS_PER_SEC);
+
+	if (headless) {
+		// ----------------------------
+		// Render every camera pose to an image
+		// ----------------------------
+		std::vector<CameraPose> poses;
+		frameCapture capture;
+		if (loadCameraPoses(options.posesPath, poses) && capture.init(options.width, options.height)) {
+			QualitySettings settings = qualityController::getBestSettings();
+
+			// Same projection as the interactive camera
+			mat4 ProjectionMatrix = glm::perspective(glm::radians(45.0f), float(options.width) / float(options.height), 0.1f, 100.0f);
+			// Model at rest, as in the first interactive frame
+			mat4 ModelMatrix = translate(mat4(1.0f), getModelPosition()) * RotationMatrix * scale(mat4(1.0f), getModelScaling());
+
+			double batchStart = glfwGetTime();
+			for (size_t i = 0; i < poses.size(); i++) {
+				mat4 ViewMatrix = glm::lookAt(poses[i].position, glm::vec3(0, 0, 0), poses[i].up);
+				renderFrame(ProjectionMatrix, ViewMatrix, ModelMatrix, settings, capture.getFramebuffer());
+
+				// Written a few poses later, once the readback is done
+				char imagePath[1024];
+				snprintf(imagePath, sizeof(imagePath), "%s/pose_%05d.bmp", options.outputDir, (int)i);
+				capture.capture(imagePath);
+			}
+			capture.finish();
+			printf("%d images in %f s\n", (int)poses.size(), glfwGetTime() - batchStart);
+		}
+		capture.release();
+	}
+	else {
+		// Frame time statistics of continuous mode
+		double statsStart = glfwGetTime();
+		int statsFrames = 0;
+
+		// Start rendering
+		do {
+			// On-demand mode: sleep until input, window or data state
+			// asks for a new frame
+			if (!options.continuousRendering) {
+				while (!consumeRedraw() && !glfwWindowShouldClose(window)) {
+					if (quality.isRefining()) {
+						// Input stopped, keep refining unless new input arrives
+						glfwWaitEventsTimeout(qualityController::REFINE_DELAY);
+						requestRedraw();
+					}
+					else {
+						glfwWaitEvents();
+					}
+				}
+				if (glfwWindowShouldClose(window)) {
+					break;
+				}
+			}
+
+			double frameStart = glfwGetTime();
+			quality.beginFrame(isInteracting(), frameStart);
+			QualitySettings settings = quality.getSettings();
+
+			// Build MVP Matrix
+			// ProjectionMatrix & ViewMatrix
+			computeMatricesFromInputs(options.width, options.height, position, up, rotX, rotY);
+			mat4 ProjectionMatrix = getProjectionMatrix();
+			mat4 ViewMatrix = getViewMatrix();
+
+			// ModelMatrix
+			vec3 modelRotation = getModelRotation();
+			// Quaternion is better than Euler Angle
+			RotationMatrix = eulerAngleYXZ(modelRotation.y, modelRotation.x, modelRotation.z) * RotationMatrix;
+			mat4 TranslationMatrix = translate(mat4(1.0f), getModelPosition());
+			mat4 ScalingMatrix = scale(mat4(1.0f), getModelScaling());
+			mat4 ModelMatrix = TranslationMatrix * RotationMatrix * ScalingMatrix;
+
+			renderFrame(ProjectionMatrix, ViewMatrix, ModelMatrix, settings, 0);
+			quality.endFrame(1000.0 * (glfwGetTime() - frameStart));
+
+			// Swap buffers
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+
+			// Print the average frame time once per second
+			if (options.continuousRendering) {
+				statsFrames++;
+				double now = glfwGetTime();
+				if (now - statsStart >= 1.0) {
+					printf("%.3f ms/frame (%d frames)\n", 1000.0 * (now - statsStart) / statsFrames, statsFrames);
+					statsStart = now;
+					statsFrames = 0;
+				}
+			}
+
+		} // Check if the ESC key was pressed or the window was closed
+		while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
+			glfwWindowShouldClose(window) == 0);
+	}
 
 	// Cleanup VBO and shader
+	drawer.release();
+	lodDrawer.release();
+	quality.release();
+	post.release();
+	deferred.release();
 	glDeleteBuffers(1, &vertexbuffer);
-	glDeleteBuffers(1, &uvbuffer);
+	glDeleteBuffers(1, &valuebuffer);
 	glDeleteBuffers(1, &normalbuffer);
 	glDeleteBuffers(1, &elementbuffer);
+	glDeleteBuffers(1, &lodElementbuffer);
 
 	glDeleteProgram(programID);
 	glDeleteProgram(depthProgramID);
-	glDeleteProgram(depthProgramID2);
-	glDeleteProgram(depthProgramID3);
 
 	glDeleteFramebuffers(1, &FramebufferName);
-	glDeleteFramebuffers(1, &FramebufferName2);
-	glDeleteFramebuffers(1, &FramebufferName3);
 
-	glDeleteTextures(1, &Texture);
+	glDeleteTextures(1, &transferTexture);
 	glDeleteTextures(1, &depthTexture);
-	glDeleteTextures(1, &depthTexture2);
-	glDeleteTextures(1, &depthTexture3);
 
 	glDeleteVertexArrays(1, &VertexArrayID);
 
@@ -0,0 +1,557 @@
+// Include standard liabraries
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+// Dual mc tables
+#include "dualmc.h"
+
+#include "dualContouring.hpp"
+
+// Eigenvalues below this fraction of the largest are dropped from the
+// pseudo inverse of A^T A, so flat and edge regions stay near the mass point
+static const double QEF_TOLERANCE = 0.1;
+// Jacobi rotation sweeps, plenty for a 3x3 matrix
+static const int QEF_SWEEPS = 6;
+
+// Eigen decomposition of the symmetric matrix m (xx, xy, xz, yy, yz, zz),
+// eigenvectors are the columns of vectors
+static void dualContouringEigen(const double m[6], double values[3], double vectors[3][3]) {
+	double a[3][3] = {
+		{ m[0], m[1], m[2] },
+		{ m[1], m[3], m[4] },
+		{ m[2], m[4], m[5] }
+	};
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			vectors[i][j] = i == j ? 1.0 : 0.0;
+		}
+	}
+	for (int sweep = 0; sweep < QEF_SWEEPS; sweep++) {
+		for (int p = 0; p < 2; p++) {
+			for (int q = p + 1; q < 3; q++) {
+				if (std::fabs(a[p][q]) < 1e-12) {
+					continue;
+				}
+				double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+				double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+				double c = 1.0 / std::sqrt(t * t + 1.0);
+				double s = t * c;
+				for (int k = 0; k < 3; k++) {
+					double kp = a[k][p];
+					double kq = a[k][q];
+					a[k][p] = c * kp - s * kq;
+					a[k][q] = s * kp + c * kq;
+				}
+				for (int k = 0; k < 3; k++) {
+					double pk = a[p][k];
+					double qk = a[q][k];
+					a[p][k] = c * pk - s * qk;
+					a[q][k] = s * pk + c * qk;
+				}
+				for (int k = 0; k < 3; k++) {
+					double kp = vectors[k][p];
+					double kq = vectors[k][q];
+					vectors[k][p] = c * kp - s * kq;
+					vectors[k][q] = s * kp + c * kq;
+				}
+			}
+		}
+	}
+	for (int i = 0; i < 3; i++) {
+		values[i] = a[i][i];
+	}
+}
+
+void dualContouring::addPlane(Qef & qef, const float normal[3], const float point[3]) {
+	double d = (double)normal[0] * point[0] + (double)normal[1] * point[1] + (double)normal[2] * point[2];
+	qef.ata[0] += (double)normal[0] * normal[0];
+	qef.ata[1] += (double)normal[0] * normal[1];
+	qef.ata[2] += (double)normal[0] * normal[2];
+	qef.ata[3] += (double)normal[1] * normal[1];
+	qef.ata[4] += (double)normal[1] * normal[2];
+	qef.ata[5] += (double)normal[2] * normal[2];
+	for (int i = 0; i < 3; i++) {
+		qef.atb[i] += normal[i] * d;
+		qef.massPoint[i] += point[i];
+	}
+	qef.btb += d * d;
+	qef.count++;
+}
+
+void dualContouring::addQef(Qef & qef, const Qef & other) {
+	for (int i = 0; i < 6; i++) {
+		qef.ata[i] += other.ata[i];
+	}
+	for (int i = 0; i < 3; i++) {
+		qef.atb[i] += other.atb[i];
+		qef.massPoint[i] += other.massPoint[i];
+	}
+	qef.btb += other.btb;
+	qef.count += other.count;
+}
+
+void dualContouring::build(
+	const uint8_t * data,
+	const int32_t dimX,
+	const int32_t dimY,
+	const int32_t dimZ,
+	const uint8_t iso,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors
+) {
+	this->data = data;
+	dims[0] = dimX;
+	dims[1] = dimY;
+	dims[2] = dimZ;
+	this->iso = iso;
+	extract(0, dimZ - 2, vertices, quads, colors, nullptr);
+}
+
+void dualContouring::buildSlab(
+	const uint8_t * data,
+	const int32_t dimX,
+	const int32_t dimY,
+	const int32_t dimZ,
+	const uint8_t iso,
+	const int32_t zBegin,
+	const int32_t zEnd,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors,
+	std::vector<size_t> & sliceQuads
+) {
+	this->data = data;
+	dims[0] = dimX;
+	dims[1] = dimY;
+	dims[2] = dimZ;
+	this->iso = iso;
+	sliceQuads.clear();
+	extract(zBegin, zEnd, vertices, quads, colors, &sliceQuads);
+}
+
+void dualContouring::extract(
+	const int32_t zBegin,
+	const int32_t zEnd,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors,
+	std::vector<size_t> * sliceQuads
+) {
+	cells[0] = dims[0] - 2;
+	cells[1] = dims[1] - 2;
+	cells[2] = dims[2] - 2;
+
+	// Same range as dualmc
+	int32_t zFirst = std::max(zBegin, 0);
+	int32_t zLast = std::min(zEnd, cells[2]);
+	vertices.clear();
+	quads.clear();
+	colors.clear();
+	if (cells[0] <= 0 || cells[1] <= 0 || zFirst >= zLast) {
+		if (sliceQuads) {
+			sliceQuads->push_back(0);
+		}
+		return;
+	}
+
+	size_t sliceCells = size_t(cells[0]) * cells[1];
+	cellLeaves.assign(sliceCells * MAX_NODE_SIZE, -1);
+	levelNodes.assign(size_t((cells[0] + 1) / 2) * ((cells[1] + 1) / 2) * (MAX_NODE_SIZE / 2), -1);
+	previousSlice.assign(sliceCells, -1);
+	previousCells.clear();
+
+	// Whole blocks from the one of the cells below the first edge slice
+	int32_t cellFirst = std::max(zFirst - 1, 0);
+	for (int32_t blockZ = cellFirst / MAX_NODE_SIZE * MAX_NODE_SIZE; blockZ < zLast; blockZ += MAX_NODE_SIZE) {
+		extractBlock(blockZ, zFirst, zLast, vertices, quads, colors, sliceQuads);
+	}
+	if (sliceQuads) {
+		sliceQuads->push_back(quads.size());
+	}
+}
+
+void dualContouring::extractBlock(
+	const int32_t blockZ,
+	const int32_t zFirst,
+	const int32_t zLast,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors,
+	std::vector<size_t> * sliceQuads
+) {
+	int32_t blockEnd = std::min(blockZ + MAX_NODE_SIZE, cells[2]);
+	size_t rowSize = dims[0];
+	size_t sliceSize = rowSize * dims[1];
+	for (int level = 0; level < LEVELS; level++) {
+		levels[level].clear();
+	}
+
+	// Leaves, the crossed cells in z, y, x order
+	for (int32_t z = blockZ; z < blockEnd; z++) {
+		for (int32_t y = 0; y < cells[1]; y++) {
+			const uint8_t * row00 = data + size_t(z) * sliceSize + size_t(y) * rowSize;
+			const uint8_t * row10 = row00 + rowSize;
+			const uint8_t * row01 = row00 + sliceSize;
+			const uint8_t * row11 = row01 + rowSize;
+			// Corner bits as in dualmc::getCellCode, the x + 1 face of one
+			// cell is the x face of the next
+			int face = (row00[0] >= iso) | (row10[0] >= iso) << 2 | (row01[0] >= iso) << 4 | (row11[0] >= iso) << 6;
+			for (int32_t x = 0; x < cells[0]; x++) {
+				int next = (row00[x + 1] >= iso) | (row10[x + 1] >= iso) << 2
+					| (row01[x + 1] >= iso) << 4 | (row11[x + 1] >= iso) << 6;
+				int cubeCode = face | next << 1;
+				face = next;
+				if (cubeCode != 0 && cubeCode != 255) {
+					addLeaf(x, y, z, cubeCode, blockZ);
+				}
+			}
+		}
+	}
+
+	// Nodes of 2, 4 and 8 cells from the level below
+	for (int level = 1; level < LEVELS; level++) {
+		std::vector<Node> & children = levels[level - 1];
+		std::vector<Node> & nodes = levels[level];
+		int32_t size = 1 << level;
+		size_t levelX = size_t(cells[0] + size - 1) >> level;
+		size_t levelY = size_t(cells[1] + size - 1) >> level;
+		for (Node & child : children) {
+			size_t position = (size_t(child.z >> 1) * levelY + size_t(child.y >> 1)) * levelX + size_t(child.x >> 1);
+			if (levelNodes[position] < 0) {
+				levelNodes[position] = (int32_t)nodes.size();
+				nodes.emplace_back();
+				Node & node = nodes.back();
+				node.qef = Qef();
+				node.x = child.x >> 1;
+				node.y = child.y >> 1;
+				node.z = child.z >> 1;
+				node.parent = -1;
+				node.vertex = -1;
+				node.cubeCode = 0;
+				node.collapsed = false;
+				node.childrenCollapsed = true;
+			}
+			child.parent = levelNodes[position];
+			Node & node = nodes[child.parent];
+			addQef(node.qef, child.qef);
+			node.childrenCollapsed = node.childrenCollapsed && child.collapsed;
+		}
+		for (Node & node : nodes) {
+			levelNodes[(size_t(node.z) * levelY + size_t(node.y)) * levelX + size_t(node.x)] = -1;
+			collapse(node, level, blockZ);
+		}
+	}
+
+	// Vertices from the top, of every collapsed node under none and every
+	// leaf under none
+	for (int level = LEVELS - 1; level >= 0; level--) {
+		for (Node & node : levels[level]) {
+			if (node.parent >= 0 && levels[level + 1][node.parent].vertex >= 0) {
+				node.vertex = levels[level + 1][node.parent].vertex;
+				continue;
+			}
+			if (level == 0) {
+				// Leaves solve their QEF only when they keep their vertex
+				float low[3] = { (float)node.x, (float)node.y, (float)node.z };
+				solveQef(node.qef, low, 1.0f, node.position);
+				node.position[2] += (float)blockZ;
+			}
+			else if (!node.collapsed) {
+				continue;
+			}
+			node.vertex = (int32_t)vertices.size();
+			vertices.emplace_back(node.position[0], node.position[1], node.position[2]);
+			// Color of the cell the vertex is in
+			int32_t vx = std::min(std::max((int32_t)node.position[0], 0), dims[0] - 1);
+			int32_t vy = std::min(std::max((int32_t)node.position[1], 0), dims[1] - 1);
+			int32_t vz = std::min(std::max((int32_t)node.position[2], 0), dims[2] - 1);
+			colors.push_back(data[size_t(vz) * sliceSize + size_t(vy) * rowSize + vx]);
+		}
+	}
+
+	// Quads of the edge slices of the block, as in dualmc::buildCellQuads,
+	// with the vertices of the nodes; corners in one node are one
+	size_t sliceCells = size_t(cells[0]) * cells[1];
+	const std::vector<Node> & leaves = levels[0];
+	size_t leaf = 0;
+	auto vertexOf = [&](const int32_t x, const int32_t y, const int32_t z) {
+		size_t cell = size_t(y) * cells[0] + x;
+		if (z < blockZ) {
+			return previousSlice[cell];
+		}
+		return leaves[cellLeaves[size_t(z - blockZ) * sliceCells + cell]].vertex;
+	};
+	auto emitQuad = [&](const int32_t i0, const int32_t i1, const int32_t i2, const int32_t i3) {
+		int32_t corners[4] = { i0, i1, i2, i3 };
+		int32_t kept[4];
+		int count = 0;
+		for (int i = 0; i < 4; i++) {
+			if (corners[i] != corners[(i + 3) & 3]) {
+				kept[count++] = corners[i];
+			}
+		}
+		if (count == 4) {
+			quads.emplace_back(kept[0], kept[1], kept[2], kept[3]);
+		}
+		else if (count == 3) {
+			quads.emplace_back(kept[0], kept[1], kept[2], kept[2]);
+		}
+	};
+	for (int32_t z = std::max(blockZ, zFirst); z < std::min(blockEnd, zLast); z++) {
+		if (sliceQuads) {
+			sliceQuads->push_back(quads.size());
+		}
+		for (; leaf < leaves.size() && leaves[leaf].z + blockZ < z; leaf++);
+		for (; leaf < leaves.size() && leaves[leaf].z + blockZ == z; leaf++) {
+			const Node & node = leaves[leaf];
+			int32_t x = node.x;
+			int32_t y = node.y;
+			int code = node.cubeCode;
+			bool inside = (code & 1) != 0;
+			int32_t i0 = node.vertex;
+			// x edge
+			if (z > 0 && y > 0 && inside != ((code & 2) != 0)) {
+				int32_t i1 = vertexOf(x, y, z - 1);
+				int32_t i2 = vertexOf(x, y - 1, z - 1);
+				int32_t i3 = vertexOf(x, y - 1, z);
+				if (!inside) {
+					emitQuad(i0, i1, i2, i3);
+				}
+				else {
+					emitQuad(i0, i3, i2, i1);
+				}
+			}
+			// y edge
+			if (z > 0 && x > 0 && inside != ((code & 4) != 0)) {
+				int32_t i1 = vertexOf(x, y, z - 1);
+				int32_t i2 = vertexOf(x - 1, y, z - 1);
+				int32_t i3 = vertexOf(x - 1, y, z);
+				if (inside) {
+					emitQuad(i0, i1, i2, i3);
+				}
+				else {
+					emitQuad(i0, i3, i2, i1);
+				}
+			}
+			// z edge
+			if (x > 0 && y > 0 && inside != ((code & 16) != 0)) {
+				int32_t i1 = vertexOf(x - 1, y, z);
+				int32_t i2 = vertexOf(x - 1, y - 1, z);
+				int32_t i3 = vertexOf(x, y - 1, z);
+				if (inside) {
+					emitQuad(i0, i1, i2, i3);
+				}
+				else {
+					emitQuad(i0, i3, i2, i1);
+				}
+			}
+		}
+	}
+
+	// Vertices of the top cell slice for the next block, and clear the
+	// leaves of the cells
+	for (size_t cell : previousCells) {
+		previousSlice[cell] = -1;
+	}
+	previousCells.clear();
+	for (const Node & node : leaves) {
+		size_t cell = size_t(node.y) * cells[0] + node.x;
+		cellLeaves[size_t(node.z) * sliceCells + cell] = -1;
+		if (node.z + blockZ == blockEnd - 1) {
+			previousSlice[cell] = node.vertex;
+			previousCells.push_back(cell);
+		}
+	}
+}
+
+void dualContouring::addLeaf(const int32_t x, const int32_t y, const int32_t z, const int cubeCode, const int32_t blockZ) {
+	size_t sliceCells = size_t(cells[0]) * cells[1];
+	cellLeaves[size_t(z - blockZ) * sliceCells + size_t(y) * cells[0] + x] = (int32_t)levels[0].size();
+	levels[0].emplace_back();
+	Node & node = levels[0].back();
+	node.qef = Qef();
+	node.x = x;
+	node.y = y;
+	node.z = z - blockZ;
+	node.parent = -1;
+	node.vertex = -1;
+	node.cubeCode = (uint8_t)cubeCode;
+	node.collapsed = true;
+	node.childrenCollapsed = true;
+
+	// Crossings of all edges, the edges of all dual points, with the
+	// gradient interpolated between the edge ends as normal
+	for (int point = 0; point < 4; point++) {
+		int edgeCount = dualmc::dualPointTables.edgeCount[cubeCode][point];
+		const uint8_t * edges = dualmc::dualPointTables.edges[cubeCode][point];
+		for (int i = 0; i < edgeCount; i++) {
+			int edge = edges[i];
+			const int32_t * corner = dualmc::edgeStart[edge];
+			int axis = dualmc::edgeAxis[edge];
+			int32_t start[3] = { x + corner[0], y + corner[1], z + corner[2] };
+			int32_t end[3] = { start[0], start[1], start[2] };
+			end[axis]++;
+			float a = (float)data[(size_t(start[2]) * dims[1] + start[1]) * dims[0] + start[0]];
+			float b = (float)data[(size_t(end[2]) * dims[1] + end[1]) * dims[0] + end[0]];
+			float t = ((float)iso - a) / (b - a);
+
+			float point[3] = { (float)start[0], (float)start[1], (float)(start[2] - blockZ) };
+			point[axis] += t;
+			float startGradient[3];
+			float endGradient[3];
+			getGradient(start[0], start[1], start[2], startGradient);
+			getGradient(end[0], end[1], end[2], endGradient);
+			float normal[3];
+			for (int k = 0; k < 3; k++) {
+				normal[k] = startGradient[k] + t * (endGradient[k] - startGradient[k]);
+			}
+			float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			if (length > 1e-6f) {
+				for (int k = 0; k < 3; k++) {
+					normal[k] /= length;
+				}
+			}
+			else {
+				// Flat gradient, the surface crosses the edge at right angles
+				normal[0] = normal[1] = normal[2] = 0.0f;
+				normal[axis] = 1.0f;
+			}
+			addPlane(node.qef, normal, point);
+		}
+	}
+}
+
+void dualContouring::collapse(Node & node, const int level, const int32_t blockZ) {
+	if (!node.childrenCollapsed) {
+		return;
+	}
+
+	// Only whole nodes, the topology test reads their far corners
+	int32_t size = 1 << level;
+	int32_t x = node.x * size;
+	int32_t y = node.y * size;
+	int32_t z = blockZ + node.z * size;
+	if (x + size > cells[0] || y + size > cells[1] || z + size > cells[2]) {
+		return;
+	}
+	if (!isTopologySafe(x, y, z, size)) {
+		return;
+	}
+
+	float low[3] = { (float)x, (float)y, (float)(z - blockZ) };
+	double error = solveQef(node.qef, low, (float)size, node.position);
+	if (error > (double)maxError * maxError * node.qef.count) {
+		return;
+	}
+	node.position[2] += (float)blockZ;
+	node.collapsed = true;
+}
+
+bool dualContouring::isTopologySafe(const int32_t x, const int32_t y, const int32_t z, const int32_t size) const {
+	// Signs at the 3x3x3 points of the node, 0, half and full size
+	int32_t half = size / 2;
+	bool signs[3][3][3];
+	for (int k = 0; k < 3; k++) {
+		for (int j = 0; j < 3; j++) {
+			for (int i = 0; i < 3; i++) {
+				signs[k][j][i] = isInside(x + i * half, y + j * half, z + k * half);
+			}
+		}
+	}
+
+	// A point at the center of an edge, a face or the node has the sign of
+	// one of the corners of that edge, face or node; else the surface
+	// crosses it more often than the node can show
+	for (int k = 0; k < 3; k++) {
+		for (int j = 0; j < 3; j++) {
+			for (int i = 0; i < 3; i++) {
+				if (i != 1 && j != 1 && k != 1) {
+					continue;
+				}
+				bool matched = false;
+				for (int corner = 0; corner < 8 && !matched; corner++) {
+					int ci = i == 1 ? (corner & 1) * 2 : i;
+					int cj = j == 1 ? (corner & 2) : j;
+					int ck = k == 1 ? (corner & 4) / 2 : k;
+					matched = signs[ck][cj][ci] == signs[k][j][i];
+				}
+				if (!matched) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+double dualContouring::solveQef(const Qef & qef, const float low[3], const float size, float position[3]) const {
+	// Minimize around the mass point with the pseudo inverse of A^T A:
+	// x = c + pinv(A^T A) (A^T b - A^T A c)
+	double center[3];
+	for (int i = 0; i < 3; i++) {
+		center[i] = qef.massPoint[i] / qef.count;
+	}
+	const double * m = qef.ata;
+	double residual[3] = {
+		qef.atb[0] - (m[0] * center[0] + m[1] * center[1] + m[2] * center[2]),
+		qef.atb[1] - (m[1] * center[0] + m[3] * center[1] + m[4] * center[2]),
+		qef.atb[2] - (m[2] * center[0] + m[4] * center[1] + m[5] * center[2])
+	};
+	double values[3];
+	double vectors[3][3];
+	dualContouringEigen(m, values, vectors);
+	double largest = std::max(std::fabs(values[0]), std::max(std::fabs(values[1]), std::fabs(values[2])));
+	double solution[3] = { center[0], center[1], center[2] };
+	for (int e = 0; e < 3; e++) {
+		if (std::fabs(values[e]) <= QEF_TOLERANCE * largest || largest == 0.0) {
+			continue;
+		}
+		double projection = (vectors[0][e] * residual[0] + vectors[1][e] * residual[1] + vectors[2][e] * residual[2]) / values[e];
+		for (int i = 0; i < 3; i++) {
+			solution[i] += vectors[i][e] * projection;
+		}
+	}
+
+	// Outside the node the vertex would fold the mesh, use the mass point
+	for (int i = 0; i < 3; i++) {
+		if (solution[i] < low[i] || solution[i] > low[i] + size) {
+			solution[0] = center[0];
+			solution[1] = center[1];
+			solution[2] = center[2];
+			break;
+		}
+	}
+
+	// x^T A^T A x - 2 x^T A^T b + b^T b
+	double product[3] = {
+		m[0] * solution[0] + m[1] * solution[1] + m[2] * solution[2],
+		m[1] * solution[0] + m[3] * solution[1] + m[4] * solution[2],
+		m[2] * solution[0] + m[4] * solution[1] + m[5] * solution[2]
+	};
+	double error = qef.btb;
+	for (int i = 0; i < 3; i++) {
+		error += solution[i] * (product[i] - 2.0 * qef.atb[i]);
+		position[i] = (float)solution[i];
+	}
+	return std::max(error, 0.0);
+}
+
+void dualContouring::getGradient(const int32_t x, const int32_t y, const int32_t z, float gradient[3]) const {
+	int32_t voxel[3] = { x, y, z };
+	size_t steps[3] = { 1, size_t(dims[0]), size_t(dims[0]) * dims[1] };
+	const uint8_t * center = data + (size_t(z) * dims[1] + y) * dims[0] + x;
+	for (int axis = 0; axis < 3; axis++) {
+		// One sided at the volume border
+		int32_t low = voxel[axis] > 0 ? 1 : 0;
+		int32_t high = voxel[axis] < dims[axis] - 1 ? 1 : 0;
+		float difference = (float)center[high * steps[axis]] - (float)center[0 - low * steps[axis]];
+		gradient[axis] = low + high > 0 ? difference / (float)(low + high) : 0.0f;
+	}
+}
+
+bool dualContouring::isInside(const int32_t x, const int32_t y, const int32_t z) const {
+	return data[(size_t(z) * dims[1] + y) * dims[0] + x] >= iso;
+}
@@ -0,0 +1,151 @@
+#ifndef DUALCONTOURING_HPP
+#define DUALCONTOURING_HPP
+
+// Adaptive dual contouring over an octree of the cells, with vertices
+// placed by quadratic error functions (QEF) of the edge crossings and
+// their normals (the volume gradient), after Ju et al., "Dual Contouring
+// of Hermite Data".
+// The volume is processed in blocks of MAX_NODE_SIZE cell slices. In a
+// block every crossed cell is a leaf, and octree nodes of 2, 4 and 8
+// cells per side are built bottom up. A node collapses into one vertex if
+// all its children did, the combined QEF stays within the error bound,
+// and the signs at its corners, edge and face centers and center keep
+// the topology of the surface. The quads of dualmc are then emitted with
+// the vertex of the largest collapsed node of each cell. Quads inside a
+// collapsed node vanish, quads with two corners in one node become
+// triangles (i3 == i2), so flat regions give few large polygons.
+// Nodes are aligned to MAX_NODE_SIZE, so slabs give the same mesh as a
+// whole volume.
+class dualContouring {
+public:
+	// Same as dualmc::build
+	void build(
+		const uint8_t * data,
+		const int32_t dimX,
+		const int32_t dimY,
+		const int32_t dimZ,
+		const uint8_t iso,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors
+	);
+
+	// Same as dualmc::buildSlab, but the whole blocks of the cells used
+	// are read, and the gradient around them: slices zBegin - 1 -
+	// MAX_NODE_SIZE to zEnd + MAX_NODE_SIZE
+	void buildSlab(
+		const uint8_t * data,
+		const int32_t dimX,
+		const int32_t dimY,
+		const int32_t dimZ,
+		const uint8_t iso,
+		const int32_t zBegin,
+		const int32_t zEnd,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors,
+		std::vector<size_t> & sliceQuads
+	);
+
+	// Root mean square distance of the crossings of a collapsed node from
+	// its vertex, in voxels
+	void setMaxError(const float maxError) { this->maxError = maxError; }
+
+	// Largest node, in cells per side
+	static const int32_t MAX_NODE_SIZE = 8;
+
+private:
+	static const int LEVELS = 4;
+
+	// Quadratic error function of the planes through the crossings,
+	// matrix A^T A (xx, xy, xz, yy, yz, zz), A^T b, b^T b, and the mean of
+	// the crossings
+	struct Qef {
+		double ata[6];
+		double atb[3];
+		double btb;
+		double massPoint[3];
+		int32_t count;
+	};
+
+	struct Node {
+		Qef qef;
+		// Position in the block, in nodes of the level
+		int32_t x, y, z;
+		// Node of the next level, -1 at the top
+		int32_t parent;
+		// Vertex of the node (its own or of a collapsed ancestor), or -1
+		int32_t vertex;
+		float position[3];
+		// Cube code, leaves only
+		uint8_t cubeCode;
+		bool collapsed;
+		bool childrenCollapsed;
+	};
+
+	void extract(
+		const int32_t zBegin,
+		const int32_t zEnd,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors,
+		std::vector<size_t> * sliceQuads
+	);
+
+	// Leaves, octree and vertices of the block of cell slices from
+	// blockZ, then the quads of its edge slices in [zFirst, zLast)
+	void extractBlock(
+		const int32_t blockZ,
+		const int32_t zFirst,
+		const int32_t zLast,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors,
+		std::vector<size_t> * sliceQuads
+	);
+
+	// Leaf of cell (x,y,z) with the QEF of its crossed edges
+	void addLeaf(const int32_t x, const int32_t y, const int32_t z, const int cubeCode, const int32_t blockZ);
+
+	// Plane through point with normal
+	static void addPlane(Qef & qef, const float normal[3], const float point[3]);
+
+	// Sum of the planes of two QEFs
+	static void addQef(Qef & qef, const Qef & other);
+
+	// Collapse node of level into one vertex if allowed
+	void collapse(Node & node, const int level, const int32_t blockZ);
+
+	// Signs at the corners, edge and face centers and center of the node
+	// of size cells at (x,y,z) are those of one surface patch
+	bool isTopologySafe(const int32_t x, const int32_t y, const int32_t z, const int32_t size) const;
+
+	// Minimizer of the QEF, clamped to the mass point if it leaves the box
+	// [low, low + size), and its error
+	double solveQef(const Qef & qef, const float low[3], const float size, float position[3]) const;
+
+	// Central difference gradient at voxel (x,y,z)
+	void getGradient(const int32_t x, const int32_t y, const int32_t z, float gradient[3]) const;
+
+	bool isInside(const int32_t x, const int32_t y, const int32_t z) const;
+
+	const uint8_t * data = nullptr;
+	int32_t dims[3] = { 0, 0, 0 };
+	uint8_t iso = 0;
+	float maxError = 0.1f;
+
+	// Cells per axis, as the cells dualmc visits
+	int32_t cells[3] = { 0, 0, 0 };
+
+	// Nodes of the block per level, leaves in z, y, x order
+	std::vector<Node> levels[LEVELS];
+	// Leaf of every cell of the block, and node of every position of a
+	// level while it is built; -1 where there is none
+	std::vector<int32_t> cellLeaves;
+	std::vector<int32_t> levelNodes;
+	// Vertex of every cell of the slice below the block, or -1
+	std::vector<int32_t> previousSlice;
+	std::vector<int32_t> previousCells;
+};
+
+#endif // DUALCONTOURING_HPP
@@ -12,13 +12,28 @@
 
 // c includes
 #include <cstdint>
+#include <cstring>
 
 // stl includes
+#include <algorithm>
 #include <unordered_map>
 #include <vector>
 
+// simd includes (SSE2, always available on x64)
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 // In uint8_t type
 class dualmc {
+	/// parallel extraction of the same mesh, shares the tables
+	friend class flyingEdges;
+	/// surface nets, with one vertex for all dual points of a cell
+	friend class surfaceNets;
+	/// adaptive dual contouring, reads the crossed edges of a cell
+	friend class dualContouring;
+
 public:
 	// vertex structure for dual points
 	struct Vertex {
@@ -31,6 +46,9 @@ public:
 		// initializing constructor
 		Vertex(const Vertex & v);
 
+		// copy assignment, declared along with the copy constructor
+		Vertex & operator=(const Vertex & v) = default;
+
 		// components
 		float x, y, z;
 	};
@@ -53,6 +71,9 @@ public:
 	/// vertices to quads.
 	/// The quad mesh either uses shared vertex indices or is a quad soup if
 	/// desired.
+	/// Extraction stops as soon as more vertices than int32_t indices can
+	/// address would be needed. vertices then holds more than INT32_MAX
+	/// entries and the mesh is incomplete, so callers check its size.
 	void build(
 		const uint8_t * data,
 		const int32_t dimX,
@@ -64,15 +85,94 @@ public:
 		std::vector<uint8_t> & colors
 	);
 
+	/// Extracts only the quads of the grid edges in slices [zBegin, zEnd),
+	/// so a volume can be meshed slab by slab. Vertices are in volume
+	/// coordinates as with build; the quads of an edge in slice z only
+	/// read slices z - 1 to z + 1.
+	/// The range is clamped to the edges build visits (0 to dimZ - 2).
+	/// sliceQuads receives the number of quads before every slice of the
+	/// clamped range, followed by the total.
+	void buildSlab(
+		const uint8_t * data,
+		const int32_t dimX,
+		const int32_t dimY,
+		const int32_t dimZ,
+		const uint8_t iso,
+		const int32_t zBegin,
+		const int32_t zEnd,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors,
+		std::vector<size_t> & sliceQuads
+	);
+
+	/// Classify cells from a volume of one bit per voxel (data >= iso),
+	/// derived at the start of every build, instead of the uint8 data.
+	/// Crossing edges are then found 64 cells at a time, and cells without
+	/// one are skipped. The mesh is the same either way. Off by default.
+	void setOccupancyMode(const bool enabled);
+
+	/// Generate a quad soup: every quad gets four vertices of its own,
+	/// so no shared vertex is looked up in pointToIndex. The quads and
+	/// vertex positions are those of the shared mesh. Off by default.
+	void setQuadSoupMode(const bool enabled);
+
+	/// Use the Manifold Dual Marching Cubes algorithm (Rephael Wenger), so
+	/// every mesh edge has at most two quads and every vertex a single fan.
+	/// Only cells with an ambiguous face (problematicConfigs) cost more.
+	/// The cells next to a slab are read too: buildSlab reads slices
+	/// zBegin - 2 to zEnd + 2. Off by default.
+	void setManifoldMode(const bool enabled);
+
 private:
-	/// Extract quad mesh with shared vertex indices.
+	/// Extract quad mesh with shared vertex indices for the edges in
+	/// slices [zBegin, zEnd), optionally recording the quad offsets of
+	/// every slice.
 	void buildSharedVerticesQuads(
 		const uint8_t iso,
+		const int32_t zBegin,
+		const int32_t zEnd,
+		std::vector<Vertex> & vertices,
+		std::vector<Quad> & quads,
+		std::vector<uint8_t> & colors,
+		std::vector<size_t> * sliceQuads
+	);
+
+private:
+
+	/// Generate the quads of the crossing grid edges starting at voxel
+	/// (x,y,z): bit 0 x edge, bit 1 y edge, bit 2 z edge. inside tells
+	/// whether the voxel is >= iso.
+	void buildCellQuads(
+		const int32_t x,
+		const int32_t y,
+		const int32_t z,
+		const uint8_t iso,
+		const int crossing,
+		const bool inside,
 		std::vector<Vertex> & vertices,
 		std::vector<Quad> & quads,
 		std::vector<uint8_t> & colors
 	);
 
+	/// Fill occupancy for slices [zBegin, zEnd)
+	void buildOccupancy(const uint8_t iso, const int32_t zBegin, const int32_t zEnd);
+
+	/// The crossing x, y and z edges buildSharedVerticesQuads visits for
+	/// the 64 cells of a word of row (y,z): occupancy XOR the next voxel,
+	/// the next row and the next slice
+	void getCrossingWords(
+		const int32_t word,
+		const int32_t y,
+		const int32_t z,
+		uint64_t & edgesX,
+		uint64_t & edgesY,
+		uint64_t & edgesZ
+	) const;
+
+	/// Index of the first word of row (y,z) in occupancy
+	size_t getOccupancyRow(const int32_t y, const int32_t z) const;
+
 private:
 
 	/// enum with edge codes for a 12-bit voxel edge mask to indicate
@@ -102,52 +202,79 @@ private:
 		const uint8_t iso
 	) const;
 
-	/// Get the 12-bit dual point code mask, which encodes the traditional
-	/// marching cube vertices of the traditional marching cubes face which
-	/// corresponds to the dual point.
-	/// This is also where the manifold dual marching cubes algorithm is
-	/// implemented.
-	int getDualPointCode(
+	/// Cube code whose dual points cell (cx,cy,cz) with code cubeCode
+	/// has. In manifold mode a C16 or C19 configuration which shares its
+	/// ambiguous face with another one is inverted.
+	int getDualPointCubeCode(
 		const int32_t cx,
 		const int32_t cy,
 		const int32_t cz,
 		const uint8_t iso,
-		const DMCEdgeCode edge
+		const int cubeCode
 	) const;
 
-	/// Given a dual point code and iso value, compute the dual point.
+	/// Index 0 to 11 of an edge code, at compile time
+	static constexpr int edgeIndex(const DMCEdgeCode edge);
+
+	/// Get the dual point of the cell cube case cubeCode which contains the
+	/// given edge, as its slot in dualPointsList[cubeCode]. The 12-bit dual
+	/// point code mask of the slot encodes the traditional marching cube
+	/// vertices of the traditional marching cubes face which corresponds
+	/// to the dual point.
+	/// This is also where the manifold dual marching cubes algorithm is
+	/// implemented.
+	template <DMCEdgeCode edge>
+	int getDualPoint(const int cubeCode) const;
+
+	/// Given a cell cube case and one of its dual points, compute the dual
+	/// point from the edges listed for it in dualPointTables. The edge
+	/// intersections are read from the slices cached by cacheEdgeSlice.
 	void calculateDualPoint(
 		const int32_t cx,
 		const int32_t cy,
 		const int32_t cz,
-		const uint8_t iso,
-		const int pointCode,
+		const int cubeCode,
+		const int point,
 		Vertex &v,
 		uint8_t & color
 	) const;
 
 	/// Get the shared index of a dual point which is uniquly identified by its
 	/// cell cube index and a cube edge. The dual point is computed,
-	/// if it has not been computed before.
+	/// if it has not been computed before (always in quad soup mode).
+	template <DMCEdgeCode edge>
 	int32_t getSharedDualPointIndex(
 		const int32_t cx, 
 		const int32_t cy, 
 		const int32_t cz,
 		const uint8_t iso,
-		const DMCEdgeCode edge,
 		std::vector<Vertex> & vertices,
 		std::vector<uint8_t> & colors
 	);
 
-	/// Compute a linearized cell cube index.
-	int32_t gA(const int32_t x, const int32_t y, const int32_t z) const;
+	/// Compute the intersection parameters of all grid edges starting in
+	/// slice z: x and y edges in the slice, z edges to slice z + 1.
+	/// Slices are kept in a ring of EDGE_SLICES, slice z in slot z % EDGE_SLICES.
+	void cacheEdgeSlice(const int32_t z, const uint8_t iso);
+
+	/// Set the volume members and the edge slice offsets of the cube edges
+	void setVolume(
+		const uint8_t * data,
+		const int32_t dimX,
+		const int32_t dimY,
+		const int32_t dimZ
+	);
+
+	/// Compute a linearized cell cube index, 64-bit so volumes of more
+	/// than 2^31 voxels can be addressed.
+	size_t gA(const int32_t x, const int32_t y, const int32_t z) const;
 
 private:
 	/// Dual Marching Cubes table
 	/// Encodes the edge vertices for the 256 marching cubes cases.
 	/// A marching cube case produces up to four faces and ,thus, up to four
 	/// dual points.
-	const int32_t dualPointsList[256][4] = {
+	static constexpr int32_t dualPointsList[256][4] = {
 		{0, 0, 0, 0}, // 0
 		{ EDGE0 | EDGE3 | EDGE8, 0, 0, 0 }, // 1
 		{ EDGE0 | EDGE1 | EDGE9, 0, 0, 0 }, // 2
@@ -409,7 +536,7 @@ private:
 	/// Table which encodes the ambiguous face of cube configurations, which
 	/// can cause non-manifold meshes.
 	/// Needed for manifold dual marching cubes.
-	const uint8_t problematicConfigs[256] = {
+	static constexpr uint8_t problematicConfigs[256] = {
 255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
 255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
 255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
@@ -428,6 +555,27 @@ private:
 255,255,255,255,255,255,4,255,255,4,255,255,255,255,255,255
 	};
 
+	/// Cube corner of every edge at which the edge starts, and the axis
+	/// the edge runs along
+	static constexpr int32_t edgeStart[12][3] = {
+		{ 0, 0, 0 }, { 1, 0, 0 }, { 0, 0, 1 }, { 0, 0, 0 },
+		{ 0, 1, 0 }, { 1, 1, 0 }, { 0, 1, 1 }, { 0, 1, 0 },
+		{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 }, { 0, 0, 1 }
+	};
+	static constexpr int32_t edgeAxis[12] = { 0, 2, 0, 2, 0, 2, 0, 2, 1, 1, 1, 1 };
+
+	/// dualPointsList unpacked at compile time: the edges of every dual
+	/// point in ascending order, and the dual point of every edge, so a
+	/// dual point is found and computed without testing edge bits.
+	struct DualPointTables {
+		uint8_t edgeCount[256][4];
+		uint8_t edges[256][4][12];
+		uint8_t edgePoint[256][12];
+
+		constexpr DualPointTables();
+	};
+	static const DualPointTables dualPointTables;
+
 private:
 	/// convenience volume extent array for x-,y-, and z-dimension
 	int32_t dims[3];
@@ -435,11 +583,40 @@ private:
 	/// convenience volume data point
 	const uint8_t * data;
 
+	/// Occupancy volume of the slices a build reads, bit x of a row is
+	/// voxel x; rows of occupancyWords words starting at slice occupancyZ
+	bool occupancyMode = false;
+	std::vector<uint64_t> occupancy;
+	int32_t occupancyWords = 0;
+	int32_t occupancyZ = 0;
+
+	/// Quad soup instead of shared vertices
+	bool quadSoupMode = false;
+
+	/// Manifold dual marching cubes
+	bool manifoldMode = false;
+
+	/// Set when a dual point found no free int32_t index, stops the build
+	bool vertexLimitReached = false;
+
+	/// Intersection parameters (iso - a) / (b - a) of the grid edges, per
+	/// slice x edges, then y edges, then z edges, each x fastest. Only the
+	/// values of edges crossing the iso surface are meaningful.
+	/// The quads of edge slice z need the cells of slices z - 1 and z,
+	/// whose edges start in slices z - 1 to z + 1.
+	static const int EDGE_SLICES = 3;
+	std::vector<float> edgeSlices[EDGE_SLICES];
+	int32_t edgeSliceZ[EDGE_SLICES];
+
+	/// offset of every cube edge from the cell in the edge slice of its
+	/// start corner (the cell's upper slice if edgeStart[edge][2] is 1)
+	int32_t edgeSliceOffsets[12];
+
 	/// Dual point key structure for hashing of shared vertices
 	struct DualPointKey {
 		// a dual point can be uniquely identified by ite linearized volume cell
 		// id and point code
-		int32_t linearizedCellID;
+		int64_t linearizedCellID;
 		int pointCode;
 		/// Equal operator for unordered map
 		bool operator==(const DualPointKey & other) const;
@@ -448,7 +625,8 @@ private:
 	/// Functor for dual point key hash generation
 	struct DualPointKeyHash {
 		size_t operator()(const DualPointKey & k) const {
-			return size_t(k.linearizedCellID) | (size_t(k.pointCode) << 32u);
+			/// cell ids stay below 2^48 voxels
+			return size_t(k.linearizedCellID) ^ (size_t(k.pointCode) << 48u);
 		}
 	};
 
@@ -488,10 +666,61 @@ inline dualmc::Quad::Quad(
 
 //------------------------------------------------------------------------------
 
-inline int32_t dualmc::gA(const int32_t x, const int32_t y, const int32_t z) const {
-	return x + dims[0] * (y + dims[1] * z);
+inline size_t dualmc::gA(const int32_t x, const int32_t y, const int32_t z) const {
+	return size_t(x) + size_t(dims[0]) * (size_t(y) + size_t(dims[1]) * size_t(z));
+}
+
+//------------------------------------------------------------------------------
+
+inline void dualmc::setOccupancyMode(const bool enabled) {
+	occupancyMode = enabled;
+}
+
+//------------------------------------------------------------------------------
+
+inline void dualmc::setQuadSoupMode(const bool enabled) {
+	quadSoupMode = enabled;
 }
 
+//------------------------------------------------------------------------------
+
+inline void dualmc::setManifoldMode(const bool enabled) {
+	manifoldMode = enabled;
+}
+
+//------------------------------------------------------------------------------
+
+inline size_t dualmc::getOccupancyRow(const int32_t y, const int32_t z) const {
+	return (size_t(z - occupancyZ) * dims[1] + y) * occupancyWords;
+}
+
+//------------------------------------------------------------------------------
+
+constexpr int dualmc::edgeIndex(const DMCEdgeCode edge) {
+	int index = 0;
+	while (!(edge & (1 << index))) {
+		++index;
+	}
+	return index;
+}
+
+//------------------------------------------------------------------------------
+
+constexpr dualmc::DualPointTables::DualPointTables() : edgeCount(), edges(), edgePoint() {
+	for (int cube = 0; cube < 256; ++cube) {
+		for (int point = 0; point < 4; ++point) {
+			for (int edge = 0; edge < 12; ++edge) {
+				if (dualPointsList[cube][point] & (1 << edge)) {
+					edges[cube][point][edgeCount[cube][point]++] = (uint8_t)edge;
+					edgePoint[cube][edge] = (uint8_t)point;
+				}
+			}
+		}
+	}
+}
+
+constexpr dualmc::DualPointTables dualmc::dualPointTables;
+
 //------------------------------------------------------------------------------
 inline bool dualmc::DualPointKey::operator==(const dualmc::DualPointKey & other) const {
 	return linearizedCellID == other.linearizedCellID && pointCode == other.pointCode;
@@ -10,6 +10,57 @@
 
 ///------------------------------------------------------------------------------
 
+/// Number of set bits
+static inline int dualmcPopCount(const uint64_t bits) {
+#ifdef _MSC_VER
+	return (int)__popcnt64(bits);
+#else
+	return __builtin_popcountll(bits);
+#endif
+}
+
+/// Index of the lowest set bit, bits must not be 0
+static inline int dualmcLowestBit(const uint64_t bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+///------------------------------------------------------------------------------
+
+/// Intersection parameters (iso - a[i]) / (b[i] - a[i]) of count edges,
+/// four at a time. Division by zero is harmless for edges that do not
+/// cross the iso surface, their parameters are never read.
+static void dualmcEdgeParams(
+	const uint8_t * a,
+	const uint8_t * b,
+	const uint8_t iso,
+	float * params,
+	const int32_t count
+) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 isoValue = _mm_set1_ps((float)iso);
+
+	int32_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		int32_t wordA, wordB;
+		memcpy(&wordA, a + i, 4);
+		memcpy(&wordB, b + i, 4);
+		__m128 valueA = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(wordA), zero), zero));
+		__m128 valueB = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(wordB), zero), zero));
+		_mm_storeu_ps(params + i, _mm_div_ps(_mm_sub_ps(isoValue, valueA), _mm_sub_ps(valueB, valueA)));
+	}
+	for (; i < count; ++i) {
+		params[i] = ((float)iso - (float)a[i]) / ((float)b[i] - (float)a[i]);
+	}
+}
+
+///------------------------------------------------------------------------------
+
 void dualmc::build(
 	const uint8_t * data,
 	const int32_t dimX,
@@ -22,115 +73,309 @@ void dualmc::build(
 ) {
 
 	/// set members
-	this->dims[0] = dimX;
-	this->dims[1] = dimY;
-	this->dims[2] = dimZ;
-	this->data = data;
+	setVolume(data, dimX, dimY, dimZ);
+
+	/// clear vertices and quad indices
+	vertices.clear();
+	quads.clear();
+
+	buildSharedVerticesQuads(iso, 0, dimZ - 2, vertices, quads, colors, nullptr);
+}
+
+///------------------------------------------------------------------------------
+
+void dualmc::buildSlab(
+	const uint8_t * data,
+	const int32_t dimX,
+	const int32_t dimY,
+	const int32_t dimZ,
+	const uint8_t iso,
+	const int32_t zBegin,
+	const int32_t zEnd,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors,
+	std::vector<size_t> & sliceQuads
+) {
+
+	/// set members
+	setVolume(data, dimX, dimY, dimZ);
 
 	/// clear vertices and quad indices
 	vertices.clear();
 	quads.clear();
+	colors.clear();
+	sliceQuads.clear();
 
-	buildSharedVerticesQuads(iso, vertices, quads, colors);
+	buildSharedVerticesQuads(iso, zBegin, zEnd, vertices, quads, colors, &sliceQuads);
 }
 
 ///------------------------------------------------------------------------------
 
 void dualmc::buildSharedVerticesQuads(
 	uint8_t const iso,
+	int32_t const zBegin,
+	int32_t const zEnd,
 	std::vector<dualmc::Vertex> & vertices,
 	std::vector<dualmc::Quad> & quads,
-	std::vector<uint8_t> & colors
+	std::vector<uint8_t> & colors,
+	std::vector<size_t> * sliceQuads
 ) {
 	int32_t const reducedX = dims[0] - 2;
 	int32_t const reducedY = dims[1] - 2;
 	int32_t const reducedZ = dims[2] - 2;
 
-	int32_t i0, i1, i2, i3;
+	int32_t const zFirst = std::max(zBegin, 0);
+	int32_t const zLast = std::min(zEnd, reducedZ);
 
 	pointToIndex.clear();
+	vertexLimitReached = false;
 
-	/// iterate voxels
-	for (int32_t z = 0; z < reducedZ; ++z)
-		for (int32_t y = 0; y < reducedY; ++y)
-			for (int32_t x = 0; x < reducedX; ++x) {
-				/// construct quads for x edge
-				if (z > 0 && y > 0) {
-					bool const entering = data[gA(x, y, z)] < iso && data[gA(x + 1, y, z)] >= iso;
-					bool const exiting = data[gA(x, y, z)] >= iso && data[gA(x + 1, y, z)] < iso;
-					if (entering || exiting) {
-						/// generate quad
-						i0 = getSharedDualPointIndex(x, y, z, iso, EDGE0, vertices, colors);
-						i1 = getSharedDualPointIndex(x, y, z - 1, iso, EDGE2, vertices, colors);
-						i2 = getSharedDualPointIndex(x, y - 1, z - 1, iso, EDGE6, vertices, colors);
-						i3 = getSharedDualPointIndex(x, y - 1, z, iso, EDGE4, vertices, colors);
-
-						if (entering) {
-							quads.emplace_back(i0, i1, i2, i3);
-						}
-						else {
-							quads.emplace_back(i0, i3, i2, i1);
-						}
-					}
-				}
+	/// edge slices are cached on first use and reused by the next slice
+	for (int i = 0; i < EDGE_SLICES; ++i) {
+		edgeSliceZ[i] = -1;
+	}
 
-				/// construct quads for y edge
-				if (z > 0 && x > 0) {
-					bool const entering = data[gA(x, y, z)] < iso && data[gA(x, y + 1, z)] >= iso;
-					bool const exiting = data[gA(x, y, z)] >= iso && data[gA(x, y + 1, z)] < iso;
-					if (entering || exiting) {
-						/// generate quad
-						i0 = getSharedDualPointIndex(x, y, z, iso, EDGE8, vertices, colors);
-						i1 = getSharedDualPointIndex(x, y, z - 1, iso, EDGE11, vertices, colors);
-						i2 = getSharedDualPointIndex(x - 1, y, z - 1, iso, EDGE10, vertices, colors);
-						i3 = getSharedDualPointIndex(x - 1, y, z, iso, EDGE9, vertices, colors);
-
-						if (exiting) {
-							quads.emplace_back(i0, i1, i2, i3);
-						}
-						else {
-							quads.emplace_back(i0, i3, i2, i1);
-						}
-					}
+	/// the quads of slice z read the cells of slices z - 1 and z, and in
+	/// manifold mode their neighbours in z
+	if (occupancyMode && zFirst < zLast) {
+		if (manifoldMode) {
+			buildOccupancy(iso, std::max(zFirst - 2, 0), std::min(zLast + 2, dims[2]));
+		}
+		else {
+			buildOccupancy(iso, std::max(zFirst - 1, 0), zLast + 1);
+		}
+		/// every crossing edge makes one quad
+		uint64_t crossings = 0;
+		for (int32_t z = zFirst; z < zLast; ++z)
+			for (int32_t y = 0; y < reducedY; ++y)
+				for (int32_t word = 0; word < occupancyWords; ++word) {
+					uint64_t edgesX, edgesY, edgesZ;
+					getCrossingWords(word, y, z, edgesX, edgesY, edgesZ);
+					crossings += dualmcPopCount(edgesX) + dualmcPopCount(edgesY) + dualmcPopCount(edgesZ);
 				}
+		quads.reserve(quads.size() + crossings);
+		if (quadSoupMode) {
+			vertices.reserve(vertices.size() + 4 * crossings);
+			colors.reserve(colors.size() + 4 * crossings);
+		}
+	}
 
-				/// construct quads for z edge
-				if (x > 0 && y > 0) {
-					bool const entering = data[gA(x, y, z)] < iso && data[gA(x, y, z + 1)] >= iso;
-					bool const exiting = data[gA(x, y, z)] >= iso && data[gA(x, y, z + 1)] < iso;
-					if (entering || exiting) {
-						/// generate quad
-						i0 = getSharedDualPointIndex(x, y, z, iso, EDGE3, vertices, colors);
-						i1 = getSharedDualPointIndex(x - 1, y, z, iso, EDGE1, vertices, colors);
-						i2 = getSharedDualPointIndex(x - 1, y - 1, z, iso, EDGE5, vertices, colors);
-						i3 = getSharedDualPointIndex(x, y - 1, z, iso, EDGE7, vertices, colors);
-
-						if (exiting) {
-							quads.emplace_back(i0, i1, i2, i3);
-						}
-						else {
-							quads.emplace_back(i0, i3, i2, i1);
-						}
+	/// iterate voxels
+	for (int32_t z = zFirst; z < zLast && !vertexLimitReached; ++z) {
+		if (sliceQuads) {
+			sliceQuads->push_back(quads.size());
+		}
+		for (int32_t s = std::max(z - 1, 0); s <= z + 1; ++s) {
+			if (edgeSliceZ[s % EDGE_SLICES] != s) {
+				cacheEdgeSlice(s, iso);
+			}
+		}
+		for (int32_t y = 0; y < reducedY && !vertexLimitReached; ++y) {
+			if (occupancyMode) {
+				/// only visit the cells with a crossing edge, 64 at a time
+				for (int32_t word = 0; word < occupancyWords; ++word) {
+					uint64_t edgesX, edgesY, edgesZ;
+					getCrossingWords(word, y, z, edgesX, edgesY, edgesZ);
+					uint64_t cells = edgesX | edgesY | edgesZ;
+					const uint64_t inside = occupancy[getOccupancyRow(y, z) + word];
+					while (cells) {
+						int const bit = dualmcLowestBit(cells);
+						cells &= cells - 1;
+						int const crossing = int((edgesX >> bit) & 1) | int((edgesY >> bit) & 1) << 1
+							| int((edgesZ >> bit) & 1) << 2;
+						buildCellQuads(64 * word + bit, y, z, iso, crossing, ((inside >> bit) & 1) != 0,
+							vertices, quads, colors);
 					}
 				}
+				continue;
+			}
+			for (int32_t x = 0; x < reducedX; ++x) {
+				bool const inside = data[gA(x, y, z)] >= iso;
+				int crossing = 0;
+				/// x edge
+				if (z > 0 && y > 0 && inside != (data[gA(x + 1, y, z)] >= iso)) {
+					crossing |= 1;
+				}
+				/// y edge
+				if (z > 0 && x > 0 && inside != (data[gA(x, y + 1, z)] >= iso)) {
+					crossing |= 2;
+				}
+				/// z edge
+				if (x > 0 && y > 0 && inside != (data[gA(x, y, z + 1)] >= iso)) {
+					crossing |= 4;
+				}
+				if (crossing) {
+					buildCellQuads(x, y, z, iso, crossing, inside, vertices, quads, colors);
+				}
+			}
+		}
+	}
+	if (sliceQuads) {
+		sliceQuads->push_back(quads.size());
+	}
+}
+
+///------------------------------------------------------------------------------
+
+void dualmc::buildCellQuads(
+	int32_t const x,
+	int32_t const y,
+	int32_t const z,
+	uint8_t const iso,
+	int const crossing,
+	bool const inside,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors
+) {
+	int32_t i0, i1, i2, i3;
+
+	/// construct quads for x edge
+	if (crossing & 1) {
+		/// generate quad
+		i0 = getSharedDualPointIndex<EDGE0>(x, y, z, iso, vertices, colors);
+		i1 = getSharedDualPointIndex<EDGE2>(x, y, z - 1, iso, vertices, colors);
+		i2 = getSharedDualPointIndex<EDGE6>(x, y - 1, z - 1, iso, vertices, colors);
+		i3 = getSharedDualPointIndex<EDGE4>(x, y - 1, z, iso, vertices, colors);
+
+		/// entering
+		if (!inside) {
+			quads.emplace_back(i0, i1, i2, i3);
+		}
+		else {
+			quads.emplace_back(i0, i3, i2, i1);
+		}
+	}
+
+	/// construct quads for y edge
+	if (crossing & 2) {
+		/// generate quad
+		i0 = getSharedDualPointIndex<EDGE8>(x, y, z, iso, vertices, colors);
+		i1 = getSharedDualPointIndex<EDGE11>(x, y, z - 1, iso, vertices, colors);
+		i2 = getSharedDualPointIndex<EDGE10>(x - 1, y, z - 1, iso, vertices, colors);
+		i3 = getSharedDualPointIndex<EDGE9>(x - 1, y, z, iso, vertices, colors);
+
+		/// exiting
+		if (inside) {
+			quads.emplace_back(i0, i1, i2, i3);
+		}
+		else {
+			quads.emplace_back(i0, i3, i2, i1);
+		}
+	}
+
+	/// construct quads for z edge
+	if (crossing & 4) {
+		/// generate quad
+		i0 = getSharedDualPointIndex<EDGE3>(x, y, z, iso, vertices, colors);
+		i1 = getSharedDualPointIndex<EDGE1>(x - 1, y, z, iso, vertices, colors);
+		i2 = getSharedDualPointIndex<EDGE5>(x - 1, y - 1, z, iso, vertices, colors);
+		i3 = getSharedDualPointIndex<EDGE7>(x, y - 1, z, iso, vertices, colors);
+
+		/// exiting
+		if (inside) {
+			quads.emplace_back(i0, i1, i2, i3);
+		}
+		else {
+			quads.emplace_back(i0, i3, i2, i1);
+		}
+	}
+}
+
+///------------------------------------------------------------------------------
+
+void dualmc::buildOccupancy(const uint8_t iso, const int32_t zBegin, const int32_t zEnd) {
+	occupancyWords = (dims[0] + 63) / 64;
+	occupancyZ = zBegin;
+	occupancy.assign(size_t(zEnd - zBegin) * dims[1] * occupancyWords, 0);
+
+	/// one bit per voxel, 16 voxels per compare
+	const __m128i isoValue = _mm_set1_epi8((char)iso);
+	for (int32_t z = zBegin; z < zEnd; ++z)
+		for (int32_t y = 0; y < dims[1]; ++y) {
+			const uint8_t * row = data + gA(0, y, z);
+			uint64_t * words = &occupancy[getOccupancyRow(y, z)];
+			int32_t x = 0;
+			for (; x + 16 <= dims[0]; x += 16) {
+				__m128i values = _mm_loadu_si128((const __m128i*)(row + x));
+				__m128i atLeastIso = _mm_cmpeq_epi8(_mm_max_epu8(values, isoValue), values);
+				words[x >> 6] |= uint64_t(_mm_movemask_epi8(atLeastIso) & 0xffff) << (x & 63);
+			}
+			for (; x < dims[0]; ++x) {
+				words[x >> 6] |= uint64_t(row[x] >= iso) << (x & 63);
 			}
+		}
+}
+
+///------------------------------------------------------------------------------
+
+void dualmc::getCrossingWords(
+	const int32_t word,
+	const int32_t y,
+	const int32_t z,
+	uint64_t & edgesX,
+	uint64_t & edgesY,
+	uint64_t & edgesZ
+) const {
+	const uint64_t * row = &occupancy[getOccupancyRow(y, z) + word];
+	const uint64_t * rowY = &occupancy[getOccupancyRow(y + 1, z) + word];
+	const uint64_t * rowZ = &occupancy[getOccupancyRow(y, z + 1) + word];
+
+	/// neighbour in x: the next bit, across the word border
+	uint64_t nextX = row[0] >> 1;
+	if (word + 1 < occupancyWords) {
+		nextX |= row[1] << 63;
+	}
+
+	/// cells x in [0, dimX - 2), y and z edges only for x > 0
+	int32_t const reducedX = dims[0] - 2;
+	int32_t const first = 64 * word;
+	uint64_t cellsX = 0;
+	if (reducedX > first) {
+		cellsX = reducedX - first >= 64 ? ~uint64_t(0) : (uint64_t(1) << (reducedX - first)) - 1;
+	}
+	uint64_t cellsYZ = word == 0 ? cellsX & ~uint64_t(1) : cellsX;
+
+	edgesX = z > 0 && y > 0 ? (row[0] ^ nextX) & cellsX : 0;
+	edgesY = z > 0 ? (row[0] ^ rowY[0]) & cellsYZ : 0;
+	edgesZ = y > 0 ? (row[0] ^ rowZ[0]) & cellsYZ : 0;
 }
 
 ///------------------------------------------------------------------------------
 
+template <dualmc::DMCEdgeCode edge>
 int32_t dualmc::getSharedDualPointIndex(
 	const int32_t cx,
 	const int32_t cy,
 	const int32_t cz,
 	const uint8_t iso,
-	const DMCEdgeCode edge,
 	std::vector<Vertex> & vertices,
 	std::vector<uint8_t> & colors
 ) {
 	/// create a key for the dual point from its linearized cell ID and point code
+	int const cubeCode = getDualPointCubeCode(cx, cy, cz, iso, getCellCode(cx, cy, cz, iso));
+	int const point = getDualPoint<edge>(cubeCode);
+
+	/// no index is left for a new vertex: give up on the build, the vertex
+	/// count already tells the caller
+	if (vertices.size() > size_t(INT32_MAX)) {
+		vertexLimitReached = true;
+		return -1;
+	}
+
+	/// every quad computes its own dual points
+	if (quadSoupMode) {
+		int32_t newVertexId = vertices.size();
+		vertices.emplace_back();
+		colors.emplace_back();
+		calculateDualPoint(cx, cy, cz, cubeCode, point, vertices.back(), colors.back());
+		return newVertexId;
+	}
+
 	DualPointKey key;
-	key.linearizedCellID = gA(cx, cy, cz);
-	key.pointCode = getDualPointCode(cx, cy, cz, iso, edge);
+	key.linearizedCellID = (int64_t)gA(cx, cy, cz);
+	key.pointCode = dualPointsList[cubeCode][point];
 
 	/// have we already computed the dual point?
 	// pointToIndex -> hash table
@@ -148,8 +393,8 @@ int32_t dualmc::getSharedDualPointIndex(
 			cx,
 			cy,
 			cz,
-			iso,
-			key.pointCode,
+			cubeCode,
+			point,
 			vertices.back(),
 			colors.back()
 		);
@@ -161,20 +406,51 @@ int32_t dualmc::getSharedDualPointIndex(
 
 ///------------------------------------------------------------------------------
 
-int dualmc::getDualPointCode(
+template <dualmc::DMCEdgeCode edge>
+int dualmc::getDualPoint(const int cubeCode) const {
+	return dualPointTables.edgePoint[cubeCode][edgeIndex(edge)];
+}
+
+///------------------------------------------------------------------------------
+
+int dualmc::getDualPointCubeCode(
 	const int32_t cx,
 	const int32_t cy,
 	const int32_t cz,
 	const uint8_t iso,
-	const DMCEdgeCode edge
+	const int cubeCode
 ) const {
-	int cubeCode = getCellCode(cx, cy, cz, iso);
+	/// The Manifold Dual Marching Cubes approach from Rephael Wenger as
+	/// described in chapter 3.3.5 of his book "Isosurfaces: Geometry,
+	/// Topology, and Algorithms". If a problematic C16 or C19 configuration
+	/// shares the ambiguous face with another C16 or C19 configuration the
+	/// cube code is inverted before looking up dual points. Doing this for
+	/// these pairs ensures manifold meshes, but removes the dualism to
+	/// marching cubes.
+	if (!manifoldMode) {
+		return cubeCode;
+	}
+	uint8_t const direction = problematicConfigs[cubeCode];
+	if (direction == 255) {
+		return cubeCode;
+	}
 
-	for (int i = 0; i < 4; ++i)
-		if (dualPointsList[cubeCode][i] & edge) {
-			return dualPointsList[cubeCode][i];
-		}
-	return 0;
+	/// the neighbour across the ambiguous face: axis direction >> 1,
+	/// positive if direction is odd
+	int32_t neighbor[3] = { cx, cy, cz };
+	int const axis = direction >> 1;
+	neighbor[axis] += (direction & 1) ? 1 : -1;
+	if (neighbor[axis] < 0 || neighbor[axis] >= dims[axis] - 1) {
+		return cubeCode;
+	}
+
+	/// C16 and C19 have exactly one ambiguous face, so a problematic
+	/// neighbour shares it
+	int const neighborCode = getCellCode(neighbor[0], neighbor[1], neighbor[2], iso);
+	if (problematicConfigs[neighborCode] != 255) {
+		return cubeCode ^ 0xff;
+	}
+	return cubeCode;
 }
 
 ///------------------------------------------------------------------------------
@@ -185,6 +461,27 @@ int dualmc::getCellCode(
 	const int32_t cz, 
 	const uint8_t iso
 ) const {
+	if (occupancyMode) {
+		/// two neighbouring bits of the four rows of the cell
+		int code = 0;
+		int32_t const word = cx >> 6;
+		int const bit = cx & 63;
+		size_t const rows[4] = {
+			getOccupancyRow(cy, cz),
+			getOccupancyRow(cy + 1, cz),
+			getOccupancyRow(cy, cz + 1),
+			getOccupancyRow(cy + 1, cz + 1)
+		};
+		for (int i = 0; i < 4; ++i) {
+			uint64_t pair = occupancy[rows[i] + word] >> bit;
+			if (bit == 63) {
+				pair |= occupancy[rows[i] + word + 1] << 1;
+			}
+			code |= int(pair & 3) << (2 * i);
+		}
+		return code;
+	}
+
 	/// determine for each cube corner if it is outside or inside
 	int code = 0;
 	if (data[gA(cx, cy, cz)] >= iso)
@@ -213,120 +510,93 @@ void dualmc::calculateDualPoint(
 	const int32_t cx,
 	const int32_t cy,
 	const int32_t cz,
-	const uint8_t iso,
-	const int pointCode, 
+	const int cubeCode,
+	const int point,
 	Vertex & v,
 	uint8_t & color
 ) const {
-	/// initialize the point with lower voxel coordinates
-	v.x = cx;
-	v.y = cy;
-	v.z = cz;
+	const uint8_t * cell = data + gA(cx, cy, cz);
 
 	// Get UV(obj) color
-	color = data[gA(cx, cy, cz)];
+	color = cell[0];
+
+	/// edge parameters of the cell's lower and upper slice
+	int32_t const cellInSlice = cx + dims[0] * cy;
+	const float * slices[2] = {
+		&edgeSlices[cz % EDGE_SLICES][cellInSlice],
+		&edgeSlices[(cz + 1) % EDGE_SLICES][cellInSlice]
+	};
 
 	/// compute the dual point as the mean of the face vertices belonging to the
 	/// original marching cubes face
-	Vertex p;
-	p.x = 0;
-	p.y = 0;
-	p.z = 0;
-	int points = 0;
-
-	/// sum edge intersection vertices using the point code
-	if (pointCode & EDGE0) {
-		p.x += ((float)iso	- (float)data[gA(cx, cy, cz)]) 
-			/ ((float)data[gA(cx + 1, cy, cz)] - (float)data[gA(cx, cy, cz)]);
-		points++;
-	}
-
-	if (pointCode & EDGE1) {
-		p.x += 1.0f;
-		p.z += ((float)iso - (float)data[gA(cx + 1, cy, cz)])
-			/ ((float)data[gA(cx + 1, cy, cz + 1)] - (float)data[gA(cx + 1, cy, cz)]);
-		points++;
-	}
-
-	if (pointCode & EDGE2) {
-		p.x += ((float)iso - (float)data[gA(cx, cy, cz + 1)])
-			/ ((float)data[gA(cx + 1, cy, cz + 1)] - (float)data[gA(cx, cy, cz + 1)]);
-		p.z += 1.0f;
-		points++;
-	}
-
-	if (pointCode & EDGE3) {
-		p.z += ((float)iso - (float)data[gA(cx, cy, cz)])
-			/ ((float)data[gA(cx, cy, cz + 1)] - (float)data[gA(cx, cy, cz)]);
-		points++;
-	}
-
-	if (pointCode & EDGE4) {
-		p.x += ((float)iso - (float)data[gA(cx, cy + 1, cz)]) 
-			/ ((float)data[gA(cx + 1, cy + 1, cz)] - (float)data[gA(cx, cy + 1, cz)]);
-		p.y += 1.0f;
-		points++;
+	float p[3] = { 0.0f, 0.0f, 0.0f };
+	int const points = dualPointTables.edgeCount[cubeCode][point];
+	uint8_t const * edges = dualPointTables.edges[cubeCode][point];
+
+	/// sum edge intersection vertices in ascending edge order. Every
+	/// component gets the edge start, plus the intersection parameter
+	/// along the edge's axis, so no component depends on a branch.
+	for (int i = 0; i < points; ++i) {
+		int const edge = edges[i];
+		float const t = slices[edgeStart[edge][2]][edgeSliceOffsets[edge]];
+		int const axis = edgeAxis[edge];
+		p[0] += (float)edgeStart[edge][0] + (axis == 0 ? t : 0.0f);
+		p[1] += (float)edgeStart[edge][1] + (axis == 1 ? t : 0.0f);
+		p[2] += (float)edgeStart[edge][2] + (axis == 2 ? t : 0.0f);
 	}
 
-	if (pointCode & EDGE5) {
-		p.x += 1.0f;
-		p.z += ((float)iso - (float)data[gA(cx + 1, cy + 1, cz)])
-			/ ((float)data[gA(cx + 1, cy + 1, cz + 1)] - (float)data[gA(cx + 1, cy + 1, cz)]);
-		p.y += 1.0f;
-		points++;
-	}
+	/// divide by number of accumulated points
+	float invPoints = 1.0f / (float)points;
+	p[0] *= invPoints;
+	p[1] *= invPoints;
+	p[2] *= invPoints;
 
-	if (pointCode & EDGE6) {
-		p.x += ((float)iso - (float)data[gA(cx, cy + 1, cz + 1)]) 
-			/ ((float)data[gA(cx + 1, cy + 1, cz + 1)] - (float)data[gA(cx, cy + 1, cz + 1)]);
-		p.z += 1.0f;
-		p.y += 1.0f;
-		points++;
-	}
+	/// offset point by voxel coordinates
+	v.x = (float)cx + p[0];
+	v.y = (float)cy + p[1];
+	v.z = (float)cz + p[2];
+}
 
-	if (pointCode & EDGE7) {
-		p.z += ((float)iso - (float)data[gA(cx, cy + 1, cz)])
-			/ ((float)data[gA(cx, cy + 1, cz + 1)] - (float)data[gA(cx, cy + 1, cz)]);
-		p.y += 1.0f;
-		points++;
-	}
+///------------------------------------------------------------------------------
 
-	if (pointCode & EDGE8) {
-		p.y += ((float)iso - (float)data[gA(cx, cy, cz)]) 
-			/ ((float)data[gA(cx, cy + 1, cz)] - (float)data[gA(cx, cy, cz)]);
-		points++;
-	}
+void dualmc::setVolume(
+	const uint8_t * data,
+	const int32_t dimX,
+	const int32_t dimY,
+	const int32_t dimZ
+) {
+	this->dims[0] = dimX;
+	this->dims[1] = dimY;
+	this->dims[2] = dimZ;
+	this->data = data;
 
-	if (pointCode & EDGE9) {
-		p.x += 1.0f;
-		p.y += ((float)iso - (float)data[gA(cx + 1, cy, cz)])
-			/ ((float)data[gA(cx + 1, cy + 1, cz)] - (float)data[gA(cx + 1, cy, cz)]);
-		points++;
+	for (int edge = 0; edge < 12; ++edge) {
+		int32_t const * start = edgeStart[edge];
+		edgeSliceOffsets[edge] = edgeAxis[edge] * dimX * dimY + start[0] + dimX * start[1];
 	}
+}
 
-	if (pointCode & EDGE10) {
-		p.x += 1.0f;
-		p.y += ((float)iso - (float)data[gA(cx + 1, cy, cz + 1)])
-			/ ((float)data[gA(cx + 1, cy + 1, cz + 1)] - (float)data[gA(cx + 1, cy, cz + 1)]);
-		p.z += 1.0f;
-		points++;
-	}
+///------------------------------------------------------------------------------
 
-	if (pointCode & EDGE11) {
-		p.z += 1.0f;
-		p.y += ((float)iso - (float)data[gA(cx, cy, cz + 1)])
-			/ ((float)data[gA(cx, cy + 1, cz + 1)] - (float)data[gA(cx, cy, cz + 1)]);
-		points++;
+void dualmc::cacheEdgeSlice(const int32_t z, const uint8_t iso) {
+	int32_t const sliceSize = dims[0] * dims[1];
+	std::vector<float> & params = edgeSlices[z % EDGE_SLICES];
+	params.resize(3 * size_t(sliceSize));
+	edgeSliceZ[z % EDGE_SLICES] = z;
+
+	const uint8_t * slice = data + gA(0, 0, z);
+	for (int32_t y = 0; y < dims[1]; ++y) {
+		const uint8_t * row = slice + dims[0] * y;
+		float * rowParams = &params[dims[0] * y];
+		/// x edges
+		dualmcEdgeParams(row, row + 1, iso, rowParams, dims[0] - 1);
+		/// y edges
+		if (y + 1 < dims[1]) {
+			dualmcEdgeParams(row, row + dims[0], iso, rowParams + sliceSize, dims[0]);
+		}
+		/// z edges
+		if (z + 1 < dims[2]) {
+			dualmcEdgeParams(row, row + sliceSize, iso, rowParams + 2 * sliceSize, dims[0]);
+		}
 	}
-
-	/// divide by number of accumulated points
-	float invPoints = 1.0f / (float)points;
-	p.x *= invPoints;
-	p.y *= invPoints;
-	p.z *= invPoints;
-
-	/// offset point by voxel coordinates
-	v.x += p.x;
-	v.y += p.y;
-	v.z += p.z;
 }
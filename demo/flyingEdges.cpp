@@ -0,0 +1,493 @@
+// Include standard liabraries
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+// Dual mc tables
+#include "dualmc.h"
+
+#include "taskScheduler.hpp"
+#include "flyingEdges.hpp"
+
+// Corner bits of a cell column (y,z), (y+1,z), (y,z+1), (y+1,z+1) to
+// their cube code bits at x
+static const uint8_t SPREAD_COLUMN[16] = {
+	0x00, 0x01, 0x04, 0x05, 0x10, 0x11, 0x14, 0x15,
+	0x40, 0x41, 0x44, 0x45, 0x50, 0x51, 0x54, 0x55
+};
+
+// Number of set bits of a 4-bit point mask
+static const uint8_t POINT_COUNT[16] = {
+	0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+void flyingEdges::build(
+	const uint8_t * data,
+	const int32_t dimX,
+	const int32_t dimY,
+	const int32_t dimZ,
+	const uint8_t iso,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors
+) {
+	this->data = data;
+	dims[0] = dimX;
+	dims[1] = dimY;
+	dims[2] = dimZ;
+	this->iso = iso;
+	extract(0, dimZ - 2, vertices, quads, colors, nullptr);
+}
+
+void flyingEdges::buildSlab(
+	const uint8_t * data,
+	const int32_t dimX,
+	const int32_t dimY,
+	const int32_t dimZ,
+	const uint8_t iso,
+	const int32_t zBegin,
+	const int32_t zEnd,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors,
+	std::vector<size_t> & sliceQuads
+) {
+	this->data = data;
+	dims[0] = dimX;
+	dims[1] = dimY;
+	dims[2] = dimZ;
+	this->iso = iso;
+	sliceQuads.clear();
+	extract(zBegin, zEnd, vertices, quads, colors, &sliceQuads);
+}
+
+void flyingEdges::extract(
+	const int32_t zBegin,
+	const int32_t zEnd,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors,
+	std::vector<size_t> * sliceQuads
+) {
+	taskScheduler & scheduler = taskScheduler::global();
+	int32_t reducedX = dims[0] - 2;
+	int32_t reducedY = dims[1] - 2;
+
+	// Same range as dualmc: edges of slices [zFirst, zLast), their quads
+	// use the cells of one slice below
+	zFirst = std::max(zBegin, 0);
+	zLast = std::min(zEnd, dims[2] - 2);
+	if (reducedX <= 0 || reducedY <= 0 || zFirst >= zLast) {
+		vertices.clear();
+		quads.clear();
+		colors.clear();
+		cells.clear();
+		if (sliceQuads) {
+			sliceQuads->push_back(0);
+		}
+		return;
+	}
+	cellZ = std::max(zFirst - 1, 0);
+
+	Range3D rows = { { 0, 0, cellZ }, { 1, reducedY, zLast } };
+	int grain[3] = { 1, ROW_GRAIN, 1 };
+
+	// 1. Count
+	size_t rowCount = size_t(reducedY) * (zLast - cellZ);
+	rowStarts.assign(rowCount + 1, RowCount());
+	scheduler.parallelFor(rows, grain, [&](const Range3D & piece) {
+		std::vector<uint8_t> codes(reducedX);
+		for (int32_t z = piece.begin[2]; z < piece.end[2]; z++) {
+			for (int32_t y = piece.begin[1]; y < piece.end[1]; y++) {
+				countRow(y, z, rowStarts[getRow(y, z) + 1], &codes[0]);
+			}
+		}
+	});
+
+	// 2. Prefix sums, the first of each row
+	for (size_t row = 0; row < rowCount; row++) {
+		rowStarts[row + 1].vertices += rowStarts[row].vertices;
+		rowStarts[row + 1].cells += rowStarts[row].cells;
+		rowStarts[row + 1].quads += rowStarts[row].quads;
+	}
+	const RowCount & total = rowStarts[rowCount];
+	Range3D quadRows = { { 0, 0, zFirst }, { 1, reducedY, zLast } };
+
+	// 3. and 4. in one for a quad soup, four vertices per quad
+	if (quadSoupMode) {
+		vertices.resize(4 * total.quads);
+		colors.resize(4 * total.quads);
+		quads.resize(total.quads);
+		cells.clear();
+		scheduler.parallelFor(quadRows, grain, [&](const Range3D & piece) {
+			std::vector<uint8_t> codes(4 * size_t(reducedX));
+			for (int32_t z = piece.begin[2]; z < piece.end[2]; z++) {
+				for (int32_t y = piece.begin[1]; y < piece.end[1]; y++) {
+					writeRowSoup(y, z, &codes[0], vertices.data(), quads.data(), colors.data());
+				}
+			}
+		});
+	}
+	else {
+		vertices.resize(total.vertices);
+		colors.resize(total.vertices);
+		quads.resize(total.quads);
+		cells.resize(total.cells);
+
+		// 3. Vertices and cell lists
+		scheduler.parallelFor(rows, grain, [&](const Range3D & piece) {
+			std::vector<uint8_t> codes(reducedX);
+			for (int32_t z = piece.begin[2]; z < piece.end[2]; z++) {
+				for (int32_t y = piece.begin[1]; y < piece.end[1]; y++) {
+					writeRowVertices(y, z, &codes[0], vertices.data(), colors.data());
+				}
+			}
+		});
+
+		// 4. Quads, of the edge slices only
+		scheduler.parallelFor(quadRows, grain, [&](const Range3D & piece) {
+			for (int32_t z = piece.begin[2]; z < piece.end[2]; z++) {
+				for (int32_t y = piece.begin[1]; y < piece.end[1]; y++) {
+					writeRowQuads(y, z, quads.data());
+				}
+			}
+		});
+	}
+
+	if (sliceQuads) {
+		for (int32_t z = zFirst; z < zLast; z++) {
+			sliceQuads->push_back(rowStarts[getRow(0, z)].quads);
+		}
+		sliceQuads->push_back(total.quads);
+	}
+}
+
+void flyingEdges::getRowCodes(const int32_t y, const int32_t z, uint8_t * codes) const {
+	size_t rowSize = dims[0];
+	size_t sliceSize = rowSize * dims[1];
+	const uint8_t * row00 = data + (size_t(z) * dims[1] + y) * rowSize;
+	const uint8_t * row10 = row00 + rowSize;
+	const uint8_t * row01 = row00 + sliceSize;
+	const uint8_t * row11 = row01 + rowSize;
+
+	// Every corner column is shared by two neighbouring cells
+	int column = (row00[0] >= iso) | (row10[0] >= iso) << 1 | (row01[0] >= iso) << 2 | (row11[0] >= iso) << 3;
+	for (int32_t x = 0; x < dims[0] - 2; x++) {
+		int next = (row00[x + 1] >= iso) | (row10[x + 1] >= iso) << 1
+			| (row01[x + 1] >= iso) << 2 | (row11[x + 1] >= iso) << 3;
+		codes[x] = SPREAD_COLUMN[column] | SPREAD_COLUMN[next] << 1;
+		column = next;
+	}
+}
+
+int flyingEdges::getQuadEdges(const int32_t x, const int32_t y, const int32_t z) const {
+	int32_t reducedX = dims[0] - 2;
+	int32_t reducedY = dims[1] - 2;
+	// Every edge of an inner cell
+	if (x >= 1 && y >= 1 && z >= std::max(zFirst, 1)
+		&& x + 1 < reducedX && y + 1 < reducedY && z + 1 < zLast) {
+		return 0xfff;
+	}
+
+	// dualmc makes quads for x edges with y, z > 0, y edges with x, z > 0
+	// and z edges with x, y > 0
+	int edges = 0;
+	for (int edge = 0; edge < 12; edge++) {
+		int axis = dualmc::edgeAxis[edge];
+		int32_t ex = x + dualmc::edgeStart[edge][0];
+		int32_t ey = y + dualmc::edgeStart[edge][1];
+		int32_t ez = z + dualmc::edgeStart[edge][2];
+		bool inside = ex >= (axis == 0 ? 0 : 1) && ex < reducedX
+			&& ey >= (axis == 1 ? 0 : 1) && ey < reducedY
+			&& ez >= (axis == 2 ? zFirst : std::max(zFirst, 1)) && ez < zLast;
+		if (inside) {
+			edges |= 1 << edge;
+		}
+	}
+	return edges;
+}
+
+int flyingEdges::getCellCode(const int32_t x, const int32_t y, const int32_t z) const {
+	size_t rowSize = dims[0];
+	size_t sliceSize = rowSize * dims[1];
+	const uint8_t * voxel = data + (size_t(z) * dims[1] + y) * rowSize + x;
+	return (voxel[0] >= iso) | (voxel[1] >= iso) << 1
+		| (voxel[rowSize] >= iso) << 2 | (voxel[rowSize + 1] >= iso) << 3
+		| (voxel[sliceSize] >= iso) << 4 | (voxel[sliceSize + 1] >= iso) << 5
+		| (voxel[sliceSize + rowSize] >= iso) << 6 | (voxel[sliceSize + rowSize + 1] >= iso) << 7;
+}
+
+int flyingEdges::getPointCode(const int32_t x, const int32_t y, const int32_t z, const int cubeCode) const {
+	if (!manifoldMode) {
+		return cubeCode;
+	}
+	int direction = dualmc::problematicConfigs[cubeCode];
+	if (direction == 255) {
+		return cubeCode;
+	}
+
+	// Invert if the neighbour across the ambiguous face is problematic too
+	int32_t neighbor[3] = { x, y, z };
+	int axis = direction >> 1;
+	neighbor[axis] += (direction & 1) ? 1 : -1;
+	if (neighbor[axis] < 0 || neighbor[axis] >= dims[axis] - 1) {
+		return cubeCode;
+	}
+	if (dualmc::problematicConfigs[getCellCode(neighbor[0], neighbor[1], neighbor[2])] != 255) {
+		return cubeCode ^ 0xff;
+	}
+	return cubeCode;
+}
+
+int flyingEdges::getUsedPoints(const int cubeCode, const int quadEdges) const {
+	int points = 0;
+	for (int point = 0; point < 4; point++) {
+		if (dualmc::dualPointsList[cubeCode][point] & quadEdges) {
+			points |= 1 << point;
+		}
+	}
+	return points;
+}
+
+void flyingEdges::countRow(const int32_t y, const int32_t z, RowCount & count, uint8_t * codes) const {
+	getRowCodes(y, z, codes);
+	for (int32_t x = 0; x < dims[0] - 2; x++) {
+		int code = codes[x];
+		if (code == 0 || code == 255) {
+			continue;
+		}
+		int quadEdges = getQuadEdges(x, y, z);
+		int points = getUsedPoints(getPointCode(x, y, z, code), quadEdges);
+		if (points) {
+			count.cells++;
+			count.vertices += POINT_COUNT[points];
+		}
+
+		// Crossing edges starting at the voxel: x (edge 0), y (edge 8)
+		// and z (edge 3)
+		int inside = code & 1;
+		count.quads += (quadEdges & dualmc::EDGE0 && inside != (code >> 1 & 1))
+			+ (quadEdges & dualmc::EDGE8 && inside != (code >> 2 & 1))
+			+ (quadEdges & dualmc::EDGE3 && inside != (code >> 4 & 1));
+	}
+}
+
+void flyingEdges::writeRowVertices(
+	const int32_t y,
+	const int32_t z,
+	uint8_t * codes,
+	dualmc::Vertex * vertices,
+	uint8_t * colors
+) {
+	const RowCount & start = rowStarts[getRow(y, z)];
+	size_t vertex = start.vertices;
+	ActiveCell * cell = cells.data() + start.cells;
+
+	getRowCodes(y, z, codes);
+	for (int32_t x = 0; x < dims[0] - 2; x++) {
+		int code = codes[x];
+		if (code == 0 || code == 255) {
+			continue;
+		}
+		int pointCode = getPointCode(x, y, z, code);
+		int points = getUsedPoints(pointCode, getQuadEdges(x, y, z));
+		if (!points) {
+			continue;
+		}
+		cell->x = x;
+		cell->firstVertex = (int32_t)vertex;
+		cell->cubeCode = (uint8_t)code;
+		cell->pointCode = (uint8_t)pointCode;
+		cell->points = (uint8_t)points;
+		cell++;
+
+		for (int point = 0; point < 4; point++) {
+			if (points & (1 << point)) {
+				computeDualPoint(x, y, z, pointCode, point, vertices[vertex], colors[vertex]);
+				vertex++;
+			}
+		}
+	}
+}
+
+void flyingEdges::computeDualPoint(
+	const int32_t x,
+	const int32_t y,
+	const int32_t z,
+	const int cubeCode,
+	const int point,
+	dualmc::Vertex & vertex,
+	uint8_t & color
+) const {
+	// Mean of the edge intersections
+	const uint8_t * voxel = data + (size_t(z) * dims[1] + y) * dims[0] + x;
+	float p[3] = { 0.0f, 0.0f, 0.0f };
+	int count = dualmc::dualPointTables.edgeCount[cubeCode][point];
+	const uint8_t * edges = dualmc::dualPointTables.edges[cubeCode][point];
+	for (int i = 0; i < count; i++) {
+		int edge = edges[i];
+		const int32_t * corner = dualmc::edgeStart[edge];
+		int axis = dualmc::edgeAxis[edge];
+		size_t offset = corner[0] + dims[0] * (corner[1] + size_t(dims[1]) * corner[2]);
+		size_t step = axis == 0 ? 1 : axis == 1 ? dims[0] : size_t(dims[0]) * dims[1];
+		float a = (float)voxel[offset];
+		float b = (float)voxel[offset + step];
+		float t = ((float)iso - a) / (b - a);
+		p[0] += (float)corner[0] + (axis == 0 ? t : 0.0f);
+		p[1] += (float)corner[1] + (axis == 1 ? t : 0.0f);
+		p[2] += (float)corner[2] + (axis == 2 ? t : 0.0f);
+	}
+	float invPoints = 1.0f / (float)count;
+	vertex.x = (float)x + p[0] * invPoints;
+	vertex.y = (float)y + p[1] * invPoints;
+	vertex.z = (float)z + p[2] * invPoints;
+	color = voxel[0];
+}
+
+void flyingEdges::writeRowQuads(const int32_t y, const int32_t z, dualmc::Quad * quads) const {
+	// Cell lists of the rows (y,z), (y-1,z), (y,z-1) and (y-1,z-1)
+	const ActiveCell * cursors[4] = { nullptr, nullptr, nullptr, nullptr };
+	const ActiveCell * ends[4] = { nullptr, nullptr, nullptr, nullptr };
+	for (int i = 0; i < 4; i++) {
+		int32_t rowY = y - (i & 1);
+		int32_t rowZ = z - (i >> 1);
+		if (rowY >= 0 && rowZ >= cellZ) {
+			size_t row = getRow(rowY, rowZ);
+			cursors[i] = cells.data() + rowStarts[row].cells;
+			ends[i] = cells.data() + rowStarts[row + 1].cells;
+		}
+	}
+
+	// Vertex of the dual point with edge of cell x in list i. A quad only
+	// uses cells that have dual points, at x - 1 or x of the cursor.
+	auto vertexOf = [&](const int i, const int32_t x, const int edge) {
+		const ActiveCell * cell = cursors[i];
+		while (cell->x < x) {
+			cell++;
+		}
+		int point = dualmc::dualPointTables.edgePoint[cell->pointCode][edge];
+		return cell->firstVertex + POINT_COUNT[cell->points & ((1 << point) - 1)];
+	};
+
+	dualmc::Quad * quad = quads + rowStarts[getRow(y, z)].quads;
+	const ActiveCell * rowEnd = ends[0];
+	for (const ActiveCell * cell = cursors[0]; cell != rowEnd; cell++) {
+		int32_t x = cell->x;
+		int code = cell->cubeCode;
+		int inside = code & 1;
+		int quadEdges = getQuadEdges(x, y, z);
+		bool edgeX = quadEdges & dualmc::EDGE0 && inside != (code >> 1 & 1);
+		bool edgeY = quadEdges & dualmc::EDGE8 && inside != (code >> 2 & 1);
+		bool edgeZ = quadEdges & dualmc::EDGE3 && inside != (code >> 4 & 1);
+		if (!(edgeX || edgeY || edgeZ)) {
+			continue;
+		}
+		for (int i = 0; i < 4; i++) {
+			while (cursors[i] && cursors[i] != ends[i] && cursors[i]->x < x - 1) {
+				cursors[i]++;
+			}
+		}
+
+		// Same quads and orientation as dualmc::buildCellQuads
+		if (edgeX) {
+			int32_t i0 = vertexOf(0, x, 0);
+			int32_t i1 = vertexOf(2, x, 2);
+			int32_t i2 = vertexOf(3, x, 6);
+			int32_t i3 = vertexOf(1, x, 4);
+			*quad++ = inside ? dualmc::Quad(i0, i3, i2, i1) : dualmc::Quad(i0, i1, i2, i3);
+		}
+		if (edgeY) {
+			int32_t i0 = vertexOf(0, x, 8);
+			int32_t i1 = vertexOf(2, x, 11);
+			int32_t i2 = vertexOf(2, x - 1, 10);
+			int32_t i3 = vertexOf(0, x - 1, 9);
+			*quad++ = inside ? dualmc::Quad(i0, i1, i2, i3) : dualmc::Quad(i0, i3, i2, i1);
+		}
+		if (edgeZ) {
+			int32_t i0 = vertexOf(0, x, 3);
+			int32_t i1 = vertexOf(0, x - 1, 1);
+			int32_t i2 = vertexOf(1, x - 1, 5);
+			int32_t i3 = vertexOf(1, x, 7);
+			*quad++ = inside ? dualmc::Quad(i0, i1, i2, i3) : dualmc::Quad(i0, i3, i2, i1);
+		}
+	}
+}
+
+void flyingEdges::writeRowSoup(
+	const int32_t y,
+	const int32_t z,
+	uint8_t * codes,
+	dualmc::Vertex * vertices,
+	dualmc::Quad * quads,
+	uint8_t * colors
+) const {
+	size_t row = getRow(y, z);
+	size_t quad = rowStarts[row].quads;
+	if (quad == rowStarts[row + 1].quads) {
+		return;
+	}
+
+	// Codes of the rows (y,z), (y-1,z), (y,z-1) and (y-1,z-1); the quads
+	// only use the rows that exist
+	int32_t reducedX = dims[0] - 2;
+	for (int i = 0; i < 4; i++) {
+		int32_t rowY = y - (i & 1);
+		int32_t rowZ = z - (i >> 1);
+		if (rowY >= 0 && rowZ >= 0) {
+			getRowCodes(rowY, rowZ, codes + i * reducedX);
+		}
+	}
+
+	// Next vertex of the quad: dual point with edge of cell x in row i
+	size_t vertex = 4 * quad;
+	auto addVertex = [&](const int i, const int32_t x, const int edge) {
+		int32_t rowY = y - (i & 1);
+		int32_t rowZ = z - (i >> 1);
+		int code = getPointCode(x, rowY, rowZ, codes[i * reducedX + x]);
+		int point = dualmc::dualPointTables.edgePoint[code][edge];
+		computeDualPoint(x, rowY, rowZ, code, point, vertices[vertex], colors[vertex]);
+		return (int32_t)vertex++;
+	};
+
+	// Same quads, vertex order and orientation as dualmc in quad soup mode
+	for (int32_t x = 0; x < reducedX; x++) {
+		int code = codes[x];
+		if (code == 0 || code == 255) {
+			continue;
+		}
+		int inside = code & 1;
+		int quadEdges = getQuadEdges(x, y, z);
+		if (quadEdges & dualmc::EDGE0 && inside != (code >> 1 & 1)) {
+			int32_t i0 = addVertex(0, x, 0);
+			int32_t i1 = addVertex(2, x, 2);
+			int32_t i2 = addVertex(3, x, 6);
+			int32_t i3 = addVertex(1, x, 4);
+			quads[quad++] = inside ? dualmc::Quad(i0, i3, i2, i1) : dualmc::Quad(i0, i1, i2, i3);
+		}
+		if (quadEdges & dualmc::EDGE8 && inside != (code >> 2 & 1)) {
+			int32_t i0 = addVertex(0, x, 8);
+			int32_t i1 = addVertex(2, x, 11);
+			int32_t i2 = addVertex(2, x - 1, 10);
+			int32_t i3 = addVertex(0, x - 1, 9);
+			quads[quad++] = inside ? dualmc::Quad(i0, i1, i2, i3) : dualmc::Quad(i0, i3, i2, i1);
+		}
+		if (quadEdges & dualmc::EDGE3 && inside != (code >> 4 & 1)) {
+			int32_t i0 = addVertex(0, x, 3);
+			int32_t i1 = addVertex(0, x - 1, 1);
+			int32_t i2 = addVertex(1, x - 1, 5);
+			int32_t i3 = addVertex(1, x, 7);
+			quads[quad++] = inside ? dualmc::Quad(i0, i1, i2, i3) : dualmc::Quad(i0, i3, i2, i1);
+		}
+	}
+}
+
+size_t flyingEdges::getRow(const int32_t y, const int32_t z) const {
+	return size_t(z - cellZ) * (dims[1] - 2) + y;
+}
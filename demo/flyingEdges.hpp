@@ -0,0 +1,152 @@
+#ifndef FLYINGEDGES_HPP
+#define FLYINGEDGES_HPP
+
+// Dual marching cubes in the style of flying edges: the same mesh as
+// dualmc, extracted in parallel into exactly sized arrays.
+// The cells are processed row by row (one y and z) on the global
+// taskScheduler:
+// 1. Count the dual points, the cells with dual points and the quads
+//    of every row.
+// 2. Prefix sums give every row its first vertex, cell and quad.
+// 3. Every row writes its vertices and a list of its cells with dual
+//    points (the first vertex of each).
+// 4. Every row writes the quads of its edges, finding the vertices of
+//    the four neighbouring cell rows by walking their cell lists.
+// No locks and no hash map. Quads come in the order of dualmc, the
+// vertices are numbered by cell instead of by first use.
+// In quad soup mode steps 3 and 4 are one: every row writes its quads
+// with four vertices each, computed from the four cell rows.
+class flyingEdges {
+public:
+	// Same as dualmc::build
+	void build(
+		const uint8_t * data,
+		const int32_t dimX,
+		const int32_t dimY,
+		const int32_t dimZ,
+		const uint8_t iso,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors
+	);
+
+	// Same as dualmc::buildSlab
+	void buildSlab(
+		const uint8_t * data,
+		const int32_t dimX,
+		const int32_t dimY,
+		const int32_t dimZ,
+		const uint8_t iso,
+		const int32_t zBegin,
+		const int32_t zEnd,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors,
+		std::vector<size_t> & sliceQuads
+	);
+
+	// Same as dualmc::setQuadSoupMode, the soup is the one of dualmc
+	void setQuadSoupMode(const bool enabled) { quadSoupMode = enabled; }
+
+	// Same as dualmc::setManifoldMode
+	void setManifoldMode(const bool enabled) { manifoldMode = enabled; }
+
+	// Cell rows per task
+	static const int ROW_GRAIN = 8;
+
+private:
+	// Cell of a row with at least one dual point
+	struct ActiveCell {
+		int32_t x;
+		int32_t firstVertex;
+		uint8_t cubeCode;
+		// Cube code of the dual points, see getPointCode
+		uint8_t pointCode;
+		// Dual points of the case (slots of dualPointsList) that are used
+		uint8_t points;
+	};
+
+	// Sizes of a cell row
+	struct RowCount {
+		size_t vertices;
+		size_t cells;
+		size_t quads;
+	};
+
+	void extract(
+		const int32_t zBegin,
+		const int32_t zEnd,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors,
+		std::vector<size_t> * sliceQuads
+	);
+
+	// Cube codes of the cells of row (y,z), from 4 voxel reads per cell
+	void getRowCodes(const int32_t y, const int32_t z, uint8_t * codes) const;
+
+	// 12-bit mask of the cube edges of cell (x,y,z) that dualmc makes
+	// quads for, in the extracted range
+	int getQuadEdges(const int32_t x, const int32_t y, const int32_t z) const;
+
+	// Cube code of cell (x,y,z) from its 8 voxels
+	int getCellCode(const int32_t x, const int32_t y, const int32_t z) const;
+
+	// Cube code whose dual points the cell has, as
+	// dualmc::getDualPointCubeCode
+	int getPointCode(const int32_t x, const int32_t y, const int32_t z, const int cubeCode) const;
+
+	// Used dual points of a cell
+	int getUsedPoints(const int cubeCode, const int quadEdges) const;
+
+	void countRow(const int32_t y, const int32_t z, RowCount & count, uint8_t * codes) const;
+	void writeRowVertices(
+		const int32_t y,
+		const int32_t z,
+		uint8_t * codes,
+		dualmc::Vertex * vertices,
+		uint8_t * colors
+	);
+	void writeRowQuads(const int32_t y, const int32_t z, dualmc::Quad * quads) const;
+	// Quads of row (y,z) with their own vertices, codes holds 4 rows
+	void writeRowSoup(
+		const int32_t y,
+		const int32_t z,
+		uint8_t * codes,
+		dualmc::Vertex * vertices,
+		dualmc::Quad * quads,
+		uint8_t * colors
+	) const;
+
+	// Dual point of cell (x,y,z), as dualmc::calculateDualPoint
+	void computeDualPoint(
+		const int32_t x,
+		const int32_t y,
+		const int32_t z,
+		const int cubeCode,
+		const int point,
+		dualmc::Vertex & vertex,
+		uint8_t & color
+	) const;
+
+	// Row index of cell row (y,z)
+	size_t getRow(const int32_t y, const int32_t z) const;
+
+	const uint8_t * data = nullptr;
+	int32_t dims[3] = { 0, 0, 0 };
+	uint8_t iso = 0;
+	bool quadSoupMode = false;
+	bool manifoldMode = false;
+
+	// Cells of rows y in [0, dimY - 2), z in [cellZ, zLast); quads of
+	// edge slices [zFirst, zLast)
+	int32_t cellZ = 0;
+	int32_t zFirst = 0;
+	int32_t zLast = 0;
+
+	// Prefix sums per row, plus the totals
+	std::vector<RowCount> rowStarts;
+	std::vector<ActiveCell> cells;
+};
+
+#endif // FLYINGEDGES_HPP
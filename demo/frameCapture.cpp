@@ -0,0 +1,121 @@
+// Include standard liabraries
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// GLEW
+#include <GL/glew.h>
+
+#include "texture.hpp"
+#include "taskScheduler.hpp"
+#include "frameCapture.hpp"
+
+bool frameCapture::init(const int width, const int height) {
+	this->width = width;
+	this->height = height;
+	// Rows padded to 4 bytes (GL_PACK_ALIGNMENT), which is also the BMP layout
+	imageSize = GLsizeiptr((width * 3 + 3) & ~3) * height;
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGB8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+	// The forward pass renders straight into this target without FXAA
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete) {
+		printf("Capture framebuffer incomplete\n");
+		return false;
+	}
+
+	for (auto & readback : ring) {
+		glGenBuffers(1, &readback.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, imageSize, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	next = 0;
+	return true;
+}
+
+void frameCapture::capture(const std::string & path) {
+	// The oldest readback has most likely finished by now
+	Readback & readback = ring[next];
+	save(readback);
+
+	// Copy into the pixel buffer on the GPU, glReadPixels returns at once
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readback.path = path;
+	next = (next + 1) % RING_SIZE;
+}
+
+void frameCapture::save(Readback & readback) {
+	if (!readback.fence) {
+		return;
+	}
+	while (glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(readback.fence);
+	readback.fence = 0;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	const unsigned char * pixels = (const unsigned char *)glMapBufferRange(
+		GL_PIXEL_PACK_BUFFER, 0, imageSize, GL_MAP_READ_BIT);
+	if (pixels) {
+		// Only the copy needs the GL thread, the file is written by a task
+		std::vector<unsigned char> image(pixels, pixels + imageSize);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		int width = this->width;
+		int height = this->height;
+		taskScheduler::global().run(writes, [path = readback.path, width, height, image = std::move(image)]() {
+			// Rows are bottom-up like in a BMP file
+			if (!saveBMP(path.c_str(), width, height, &image[0])) {
+				printf("Failed to write %s\n", path.c_str());
+			}
+		});
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void frameCapture::finish() {
+	for (int i = 0; i < RING_SIZE; i++) {
+		save(ring[(next + i) % RING_SIZE]);
+	}
+	taskScheduler::global().wait(writes);
+}
+
+void frameCapture::release() {
+	taskScheduler::global().wait(writes);
+	for (auto & readback : ring) {
+		if (readback.fence) {
+			glDeleteSync(readback.fence);
+			readback.fence = 0;
+		}
+		glDeleteBuffers(1, &readback.buffer);
+	}
+	glDeleteRenderbuffers(1, &depthBuffer);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+}
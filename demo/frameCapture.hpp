@@ -0,0 +1,53 @@
+#ifndef FRAMECAPTURE_HPP
+#define FRAMECAPTURE_HPP
+
+// Offscreen output of the headless mode.
+// Frames are read back into a ring of pixel buffer objects, so the
+// GPU keeps rendering the next poses while earlier images are copied,
+// and the images are written to disk by taskScheduler tasks.
+class frameCapture {
+public:
+	// Returns false if the framebuffer is incomplete
+	bool init(const int width, const int height);
+
+	// Final image target, use instead of the window's framebuffer
+	GLuint getFramebuffer() const { return framebuffer; }
+
+	// Start reading the current image back, it is saved to path
+	// (.bmp) once the readback has finished
+	void capture(const std::string & path);
+
+	// Wait for and save every pending image
+	void finish();
+
+	void release();
+
+private:
+	// Readbacks in flight
+	static const int RING_SIZE = 3;
+
+	struct Readback {
+		GLuint buffer = 0;
+		GLsync fence = 0;
+		std::string path;
+	};
+
+	// Wait for the slot's readback and start writing its image
+	void save(Readback & readback);
+
+	int width = 0;
+	int height = 0;
+	GLsizeiptr imageSize = 0;
+
+	GLuint framebuffer = 0;
+	GLuint colorBuffer = 0;
+	GLuint depthBuffer = 0;
+
+	Readback ring[RING_SIZE];
+	int next = 0;
+
+	// Images being written
+	taskGroup writes;
+};
+
+#endif // FRAMECAPTURE_HPP
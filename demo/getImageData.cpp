@@ -1,11 +1,22 @@
 #include <Windows.h>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
+#include "taskScheduler.hpp"
 #include "getImageData.hpp"
 
 // Inclued WANLI's file
 #include "converttobmp.h"
 
+// Rows of a slice per task
+static const int ROW_GRAIN = 32;
+
 void getImageData(
 		const char* path, 
 		std::vector<uint8_t> &raw,
@@ -15,16 +26,20 @@ void getImageData(
 		int &rescale_intercept,
 		unsigned short &rescale_slope
 ){
-	// Struct see converttobmp.h file
-	//struct DcmData {
-	//	unsigned char * buffer;		//ļͼ
-	//	unsigned short columns;		//
-	//	unsigned short rows;		//
-	//	int countImages;			//ļͼ
-	//	size_t bufferSize;			//ݴС
-	//	int RescaleIntercept;		//Rescale Intercept
-	//	unsigned short RescaleSlope;			//Rescale Slope
-	//};
+	getImageSlices(path, raw, dimX, dimY, dimZ, rescale_intercept, rescale_slope,
+		[](unsigned int) { return true; });
+}
+
+void getImageSlices(
+		const char* path,
+		std::vector<uint8_t> &raw,
+		unsigned int &dimX,
+		unsigned int &dimY,
+		unsigned int &dimZ,
+		int &rescale_intercept,
+		unsigned short &rescale_slope,
+		const std::function<bool(unsigned int)> &onSlice
+){
 	DcmData data;
 	int bufferSize = converttobmp(
 		path,
@@ -39,21 +54,32 @@ void getImageData(
 	rescale_slope = data.RescaleSlope;
 
 	// char size == dim of x (height) * dim of y (width) * dim of z(total number of dcm files)
-	raw.resize(data.rows*data.columns*data.countImages);
+	// in size_t, big studies have more than 2^32 voxels
+	raw.resize(size_t(data.rows) * data.columns * data.countImages);
 
+	taskScheduler & scheduler = taskScheduler::global();
 	for (int z = 0; z < dimZ; z++)
 	{
-		for (int y = 0; y < dimY; y++)
+		// Rows of the slice in parallel
+		scheduler.parallelFor(0, (int)dimY, ROW_GRAIN, [&](int yBegin, int yEnd)
 		{
-			for (int x = 0; x < dimX; x++)
+			for (int y = yBegin; y < yEnd; y++)
 			{
-				uint8_t tmp = data.buffer[
-					(x + y * dimX + z * dimX * dimY) * 4
-					+ sizeof(BITMAPFILEHEADER)*(z+1)
-					+ sizeof(BITMAPINFOHEADER)*(z+1)
-				];
-				raw[x + y * dimX + z * dimX * dimY] = tmp;
+				for (int x = 0; x < dimX; x++)
+				{
+					size_t voxel = x + y * size_t(dimX) + z * size_t(dimX) * dimY;
+					uint8_t tmp = data.buffer[
+						voxel * 4
+						+ sizeof(BITMAPFILEHEADER)*(z+1)
+						+ sizeof(BITMAPINFOHEADER)*(z+1)
+					];
+					raw[voxel] = tmp;
+				}
 			}
+		});
+		if (!onSlice(z))
+		{
+			break;
 		}
 	}
 
@@ -67,43 +93,88 @@ void removeNoise(
 	unsigned int &dimZ,
 	uint8_t threshold
 ) {
-	for (int z = 0; z < dimZ; z++)
+	noiseFilter filter;
+	filter.init(dimX, dimY, dimZ, threshold);
+	for (unsigned int z = 0; z < dimZ; z++)
+	{
+		filter.addSlice(raw, z);
+	}
+}
+
+void noiseFilter::init(
+	const unsigned int dimX,
+	const unsigned int dimY,
+	const unsigned int dimZ,
+	const uint8_t threshold
+) {
+	this->dimX = dimX;
+	this->dimY = dimY;
+	this->dimZ = dimZ;
+	this->threshold = threshold;
+	// Fixed number 0.3 * size of Z
+	minRun = (unsigned int)(0.3 * dimZ);
+	runStart.assign(size_t(dimX) * dimY, int(NO_RUN));
+}
+
+unsigned int noiseFilter::addSlice(std::vector<uint8_t> &raw, const unsigned int z)
+{
+	size_t sliceSize = size_t(dimX) * dimY;
+	uint8_t * slice = &raw[z * sliceSize];
+	std::atomic<int> firstOpen((int)z + 1);
+
+	// Columns are independent, rows of the slice in parallel
+	taskScheduler::global().parallelFor(0, (int)dimY, ROW_GRAIN, [&](int yBegin, int yEnd)
 	{
-		for (int y = 0; y < dimY; y++)
+		int rowsFirstOpen = (int)z + 1;
+		for (size_t i = yBegin * size_t(dimX); i < yEnd * size_t(dimX); i++)
 		{
-			for (int x = 0; x < dimX; x++)
+			int start = runStart[i];
+			// If current grayscale is larger than threshold
+			// the run of this column goes on
+			if (slice[i] >= threshold)
 			{
-				// If current grayscale is larger than threshold
-				// do search
-				if (raw[x + y * dimX + z * dimX * dimY]
-					>= threshold)
+				if (start == REMOVING)
 				{
-					int zz = z;
-					int same = 0;
-					do
+					slice[i] = 0;
+				}
+				else
+				{
+					if (start == NO_RUN)
 					{
-						if (raw[x + y * dimX + zz * dimX * dimY]
-								>= threshold)
-						{
-							same++;
-							zz++;
-						}
-						else
-						{
-							break;
-						}
-					} while (zz < dimZ);
-
-					// Fixed number 0.1 * size of Z
-					if (same >= unsigned int(0.3*dimZ)) // 0.1 * dimZ
+						start = (int)z;
+					}
+					// Long enough to be noise, remove what is known of it
+					if (z - start + 1 >= minRun)
 					{
-						for (int i = 0; i < same; i++)
+						for (int zz = start; zz <= (int)z; zz++)
 						{
-							raw[x + y * dimX + (z+i) * dimX * dimY] = 0;
+							raw[i + zz * sliceSize] = 0;
 						}
+						start = REMOVING;
 					}
-				} // IF END
-			} // FOR X END
-		} // FOR Y END
-	} // FOR Z END
-}
\ No newline at end of file
+				}
+			}
+			else
+			{
+				start = NO_RUN;
+			}
+			runStart[i] = start;
+			if (start >= 0 && start < rowsFirstOpen)
+			{
+				rowsFirstOpen = start;
+			}
+		}
+
+		int current = firstOpen.load();
+		while (rowsFirstOpen < current && !firstOpen.compare_exchange_weak(current, rowsFirstOpen))
+		{
+		}
+	});
+
+	// Runs still open at the last slice are kept
+	if (z + 1 == dimZ)
+	{
+		return dimZ;
+	}
+	return (unsigned int)firstOpen.load();
+}
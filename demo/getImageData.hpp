@@ -19,4 +19,49 @@ void removeNoise(
 	uint8_t threshold
 );
 
+// getImageData, calling onSlice(z) as soon as slice z of raw is filled.
+// Slices come in order; raw and the sizes are set before the first call.
+// Returning false from onSlice stops early.
+void getImageSlices(
+	const char* path,
+	std::vector<uint8_t> &raw,
+	unsigned int &dimX,
+	unsigned int &dimY,
+	unsigned int &dimZ,
+	int &rescale_intercept,
+	unsigned short &rescale_slope,
+	const std::function<bool(unsigned int)> &onSlice
+);
+
+// removeNoise one slice at a time, so filtering can follow decoding.
+// A run of voxels >= threshold along z is noise if it is at least
+// 0.3 * dimZ long, so a slice is only final once every run through it
+// has ended or reached that length.
+class noiseFilter {
+public:
+	void init(
+		const unsigned int dimX,
+		const unsigned int dimY,
+		const unsigned int dimZ,
+		const uint8_t threshold
+	);
+
+	// Filter slice z of raw; slices have to come in order.
+	// Returns the number of leading slices that are final.
+	unsigned int addSlice(std::vector<uint8_t> &raw, const unsigned int z);
+
+private:
+	// Column states besides the first slice of an open run
+	static const int NO_RUN = -1;
+	static const int REMOVING = -2;
+
+	unsigned int dimX = 0;
+	unsigned int dimY = 0;
+	unsigned int dimZ = 0;
+	uint8_t threshold = 0;
+	unsigned int minRun = 0;
+	// Per column
+	std::vector<int> runStart;
+};
+
 #endif
\ No newline at end of file
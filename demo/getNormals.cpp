@@ -1,55 +1,71 @@
 #include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 //#include <unordered_map>
 
 #include <glm/glm.hpp>
 
+#include "taskScheduler.hpp"
 #include "getNormals.hpp"
 
+// Faces or vertices per task
+static const int NORMAL_GRAIN = 16384;
+
 std::vector<glm::vec3> getVertexNormals(
 	const std::vector<glm::vec3> &objVertices,
 	const std::vector<unsigned int> &objFaces)
 {
-	std::vector<glm::vec3> normals;
-	// Use an array to save vertex normal data
-	glm::vec3 *faceArr = new glm::vec3[objVertices.size()];
-	memset(faceArr, 0, sizeof(glm::vec3) * objVertices.size());
-
-	// Add surface normal vector
-	for (int i = 0; i < objFaces.size(); i += 3) {
-
-		// First triangle
-		glm::vec3 faceNorm = getNormal(
-			objVertices[objFaces.at(i)],
-			objVertices[objFaces.at(i + 1)],
-			objVertices[objFaces.at(i + 2)])
-			* getArea(
-				objVertices[objFaces.at(i)],
-				objVertices[objFaces.at(i + 1)],
-				objVertices[objFaces.at(i + 2)]);
-
-		// Vertex 1
-		faceArr[objFaces.at(i)] += faceNorm;
-		// Vertex 2
-		faceArr[objFaces.at(i+1)] += faceNorm;
-		// Vertex 3
-		faceArr[objFaces.at(i+2)] += faceNorm;
+	taskScheduler & scheduler = taskScheduler::global();
+	int faceCount = (int)(objFaces.size() / 3);
+	int vertexCount = (int)objVertices.size();
+
+	// Area weighted surface normal of every face, in parallel
+	std::vector<glm::vec3> faceNorms(faceCount);
+	scheduler.parallelFor(0, faceCount, NORMAL_GRAIN, [&](int begin, int end) {
+		for (int face = begin; face < end; face++) {
+			const glm::vec3 &vertex1 = objVertices[objFaces[3 * face]];
+			const glm::vec3 &vertex2 = objVertices[objFaces[3 * face + 1]];
+			const glm::vec3 &vertex3 = objVertices[objFaces[3 * face + 2]];
+			faceNorms[face] = getNormal(vertex1, vertex2, vertex3)
+				* getArea(vertex1, vertex2, vertex3);
+		}
+	});
 
+	// Faces of every vertex, in face order
+	std::vector<unsigned int> firstFace(vertexCount + 1, 0);
+	for (size_t i = 0; i < objFaces.size(); i++) {
+		firstFace[objFaces[i] + 1]++;
 	}
-
-	// Build normals
-	for (int i = 0; i < objVertices.size(); i++)
-	{
-		glm::vec3 normal = faceArr[i];
-		normal = glm::normalize(normal);
-		normals.push_back(normal);
+	for (int i = 0; i < vertexCount; i++) {
+		firstFace[i + 1] += firstFace[i];
+	}
+	std::vector<unsigned int> vertexFaces(objFaces.size());
+	std::vector<unsigned int> filled(firstFace.begin(), firstFace.end() - 1);
+	for (size_t i = 0; i < objFaces.size(); i++) {
+		vertexFaces[filled[objFaces[i]]++] = (unsigned int)(i / 3);
 	}
 
-	delete faceArr;
+	// Build normals, in parallel. Every vertex adds its faces in face
+	// order, the same sums as adding each face to its three vertices.
+	std::vector<glm::vec3> normals(vertexCount);
+	scheduler.parallelFor(0, vertexCount, NORMAL_GRAIN, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			glm::vec3 normal(0.0f);
+			for (unsigned int j = firstFace[i]; j < firstFace[i + 1]; j++) {
+				normal += faceNorms[vertexFaces[j]];
+			}
+			normals[i] = glm::normalize(normal);
+		}
+	});
 
 	return normals;
 }
 
-
 // Get surface normal vector.
 // It seems we do not need to use this function.
 std::vector<glm::vec3> getNormals(
@@ -0,0 +1,291 @@
+// Include standard liabraries
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// GLEW
+#include <GL/glew.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "meshChunks.hpp"
+
+void buildMeshChunks(
+	const std::vector<glm::vec3> & vertices,
+	std::vector<unsigned int> & faces,
+	std::vector<MeshChunk> & chunks,
+	const unsigned int chunkGrid
+) {
+	chunks.clear();
+	if (vertices.empty() || faces.empty()) {
+		return;
+	}
+
+	// Bounds of the whole mesh
+	glm::vec3 meshMin = vertices[0];
+	glm::vec3 meshMax = vertices[0];
+	for (auto const & v : vertices) {
+		meshMin = glm::min(meshMin, v);
+		meshMax = glm::max(meshMax, v);
+	}
+	glm::vec3 cellScale = float(chunkGrid) / glm::max(meshMax - meshMin, glm::vec3(1e-6f));
+
+	// Cell of every triangle, by centroid
+	size_t triangleCount = faces.size() / 3;
+	std::vector<unsigned int> triangleCell(triangleCount);
+	std::vector<unsigned int> cellCount(chunkGrid * chunkGrid * chunkGrid + 1, 0);
+	for (size_t t = 0; t < triangleCount; t++) {
+		glm::vec3 centroid = (vertices[faces[3 * t]]
+			+ vertices[faces[3 * t + 1]]
+			+ vertices[faces[3 * t + 2]]) / 3.0f;
+		glm::uvec3 cell = glm::min(
+			glm::uvec3((centroid - meshMin) * cellScale),
+			glm::uvec3(chunkGrid - 1));
+		// x fastest, so neighbouring cells are neighbours in the buffer too
+		unsigned int c = cell.x + chunkGrid * (cell.y + chunkGrid * cell.z);
+		triangleCell[t] = c;
+		cellCount[c + 1]++;
+	}
+
+	// Counting sort of triangles by cell
+	for (size_t c = 1; c < cellCount.size(); c++) {
+		cellCount[c] += cellCount[c - 1];
+	}
+	std::vector<unsigned int> sorted(faces.size());
+	std::vector<unsigned int> cursor(cellCount.begin(), cellCount.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		unsigned int dst = cursor[triangleCell[t]]++;
+		sorted[3 * dst] = faces[3 * t];
+		sorted[3 * dst + 1] = faces[3 * t + 1];
+		sorted[3 * dst + 2] = faces[3 * t + 2];
+	}
+	faces.swap(sorted);
+
+	// One chunk per non-empty cell with tight bounds
+	for (size_t c = 0; c + 1 < cellCount.size(); c++) {
+		unsigned int first = cellCount[c];
+		unsigned int last = cellCount[c + 1];
+		if (first == last) {
+			continue;
+		}
+		MeshChunk chunk;
+		chunk.firstIndex = first * 3;
+		chunk.indexCount = (last - first) * 3;
+		chunk.boxMin = vertices[faces[chunk.firstIndex]];
+		chunk.boxMax = chunk.boxMin;
+		for (unsigned int i = chunk.firstIndex; i < chunk.firstIndex + chunk.indexCount; i++) {
+			chunk.boxMin = glm::min(chunk.boxMin, vertices[faces[i]]);
+			chunk.boxMax = glm::max(chunk.boxMax, vertices[faces[i]]);
+		}
+		chunks.push_back(chunk);
+	}
+}
+
+void buildClusteredLOD(
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<unsigned int> & faces,
+	const unsigned int lodGrid,
+	std::vector<unsigned int> & lodFaces
+) {
+	lodFaces.clear();
+	if (vertices.empty()) {
+		return;
+	}
+
+	glm::vec3 meshMin = vertices[0];
+	glm::vec3 meshMax = vertices[0];
+	for (auto const & v : vertices) {
+		meshMin = glm::min(meshMin, v);
+		meshMax = glm::max(meshMax, v);
+	}
+	glm::vec3 cellScale = float(lodGrid) / glm::max(meshMax - meshMin, glm::vec3(1e-6f));
+
+	// Representative (first) vertex of every occupied cell
+	std::unordered_map<uint64_t, unsigned int> cellVertex;
+	std::vector<unsigned int> remap(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		glm::uvec3 cell = glm::min(
+			glm::uvec3((vertices[i] - meshMin) * cellScale),
+			glm::uvec3(lodGrid - 1));
+		uint64_t key = cell.x + uint64_t(lodGrid) * (cell.y + uint64_t(lodGrid) * cell.z);
+		remap[i] = cellVertex.emplace(key, (unsigned int)i).first->second;
+	}
+
+	// Keep triangles whose corners are still distinct
+	for (size_t i = 0; i + 2 < faces.size(); i += 3) {
+		unsigned int a = remap[faces[i]];
+		unsigned int b = remap[faces[i + 1]];
+		unsigned int c = remap[faces[i + 2]];
+		if (a != b && b != c && a != c) {
+			lodFaces.push_back(a);
+			lodFaces.push_back(b);
+			lodFaces.push_back(c);
+		}
+	}
+}
+
+void getFrustumPlanes(const glm::mat4 & MVP, glm::vec4 planes[6]) {
+	// Gribb & Hartmann: planes are sums/differences of the rows of MVP.
+	// glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++) {
+		row[i] = glm::vec4(MVP[0][i], MVP[1][i], MVP[2][i], MVP[3][i]);
+	}
+	planes[0] = row[3] + row[0]; // Left
+	planes[1] = row[3] - row[0]; // Right
+	planes[2] = row[3] + row[1]; // Bottom
+	planes[3] = row[3] - row[1]; // Top
+	planes[4] = row[3] + row[2]; // Near
+	planes[5] = row[3] - row[2]; // Far
+}
+
+bool isBoxInFrustum(
+	const glm::vec4 planes[6],
+	const glm::vec3 & boxMin,
+	const glm::vec3 & boxMax
+) {
+	for (int i = 0; i < 6; i++) {
+		// Corner of the box furthest along the plane normal
+		glm::vec3 p(
+			planes[i].x >= 0 ? boxMax.x : boxMin.x,
+			planes[i].y >= 0 ? boxMax.y : boxMin.y,
+			planes[i].z >= 0 ? boxMax.z : boxMin.z
+		);
+		if (glm::dot(glm::vec3(planes[i]), p) + planes[i].w < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void chunkDrawer::init(const std::vector<MeshChunk> & chunks, const int passCount) {
+	this->chunks = chunks;
+	this->passCount = passCount;
+	frame = 0;
+	commands.reserve(chunks.size());
+
+	// Software GL (Mesa llvmpipe) exposes both, so the indirect path
+	// can be tested without a GPU.
+	indirect = GLEW_ARB_multi_draw_indirect && GLEW_ARB_buffer_storage && !chunks.empty();
+	if (!indirect) {
+		printf("Multi draw indirect not supported, using glDrawElements per chunk\n");
+		return;
+	}
+
+	// One region per pass per frame in flight
+	GLsizeiptr size = GLsizeiptr(RING_SIZE) * passCount * chunks.size()
+		* sizeof(DrawElementsIndirectCommand);
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &indirectBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+	glBufferStorage(GL_DRAW_INDIRECT_BUFFER, size, nullptr, flags);
+	mapped = (DrawElementsIndirectCommand *)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, size, flags);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void chunkDrawer::beginFrame() {
+	GLsync & fence = fences[frame];
+	if (fence) {
+		// Commands of this slot may still be read by the GPU
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fence);
+		fence = 0;
+	}
+}
+
+unsigned int chunkDrawer::draw(const int pass, const glm::mat4 & MVP) {
+	return draw(pass, &MVP, 1);
+}
+
+unsigned int chunkDrawer::draw(const int pass, const glm::mat4 * MVPs, const int mvpCount) {
+	planes.resize(6 * mvpCount);
+	for (int i = 0; i < mvpCount; i++) {
+		getFrustumPlanes(MVPs[i], &planes[6 * i]);
+	}
+
+	// Collect visible chunks, merging runs which are adjacent in the
+	// buffer. The mapping is write-only, so commands are built here and
+	// copied over when done.
+	commands.clear();
+	GLuint runEnd = 0;
+	unsigned int visible = 0;
+	for (auto const & chunk : chunks) {
+		bool inside = false;
+		for (int i = 0; i < mvpCount && !inside; i++) {
+			inside = isBoxInFrustum(&planes[6 * i], chunk.boxMin, chunk.boxMax);
+		}
+		if (!inside) {
+			continue;
+		}
+		visible++;
+		if (!commands.empty() && runEnd == chunk.firstIndex) {
+			commands.back().count += chunk.indexCount;
+			runEnd += chunk.indexCount;
+			continue;
+		}
+		DrawElementsIndirectCommand cmd;
+		cmd.count = chunk.indexCount;
+		cmd.instanceCount = 1;
+		cmd.firstIndex = chunk.firstIndex;
+		cmd.baseVertex = 0;
+		cmd.baseInstance = 0;
+		commands.push_back(cmd);
+		runEnd = chunk.firstIndex + chunk.indexCount;
+	}
+	GLsizei drawCount = (GLsizei)commands.size();
+	if (drawCount == 0) {
+		return 0;
+	}
+
+	if (indirect) {
+		size_t offset = (size_t(frame) * passCount + pass) * chunks.size();
+		memcpy(mapped + offset, commands.data(), drawCount * sizeof(DrawElementsIndirectCommand));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glMultiDrawElementsIndirect(
+			GL_TRIANGLES,
+			GL_UNSIGNED_INT,
+			(void*)(offset * sizeof(DrawElementsIndirectCommand)),
+			drawCount,
+			0
+		);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	else {
+		for (GLsizei i = 0; i < drawCount; i++) {
+			glDrawElements(
+				GL_TRIANGLES,
+				commands[i].count,
+				GL_UNSIGNED_INT,
+				(void*)(size_t(commands[i].firstIndex) * sizeof(unsigned int))
+			);
+		}
+	}
+	return visible;
+}
+
+void chunkDrawer::endFrame() {
+	if (indirect) {
+		fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	frame = (frame + 1) % RING_SIZE;
+}
+
+void chunkDrawer::release() {
+	for (auto & fence : fences) {
+		if (fence) {
+			glDeleteSync(fence);
+			fence = 0;
+		}
+	}
+	if (indirectBuffer) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		glDeleteBuffers(1, &indirectBuffer);
+		indirectBuffer = 0;
+	}
+	mapped = nullptr;
+}
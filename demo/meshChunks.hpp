@@ -0,0 +1,101 @@
+#ifndef MESHCHUNKS_HPP
+#define MESHCHUNKS_HPP
+
+// A run of triangles in the element buffer and its model space bounds.
+// Chunks are spatially compact, so they can be culled one by one.
+struct MeshChunk {
+	glm::vec3 boxMin;
+	glm::vec3 boxMax;
+	unsigned int firstIndex;
+	unsigned int indexCount;
+};
+
+// Command layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Sort faces into a grid of chunkGrid^3 cells (by triangle centroid)
+// and return one chunk per non-empty cell.
+// faces are reordered in place, so call it before uploading them.
+void buildMeshChunks(
+	const std::vector<glm::vec3> & vertices,
+	std::vector<unsigned int> & faces,
+	std::vector<MeshChunk> & chunks,
+	const unsigned int chunkGrid
+);
+
+// Cheap level of detail by vertex clustering.
+// Vertices are snapped to the first vertex of their cell in a grid of
+// lodGrid^3 cells, triangles which collapse are dropped. The result
+// indexes the original vertex buffer, so only an index buffer is added.
+void buildClusteredLOD(
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<unsigned int> & faces,
+	const unsigned int lodGrid,
+	std::vector<unsigned int> & lodFaces
+);
+
+// Extract the six clip planes of a view-projection matrix.
+// Planes are in the space MVP transforms from (model space for MVP).
+void getFrustumPlanes(const glm::mat4 & MVP, glm::vec4 planes[6]);
+
+// Test an AABB against frustum planes (conservative)
+bool isBoxInFrustum(
+	const glm::vec4 planes[6],
+	const glm::vec3 & boxMin,
+	const glm::vec3 & boxMax
+);
+
+// Culls chunks per pass and submits the visible ones with
+// glMultiDrawElementsIndirect from a persistently mapped buffer.
+// Falls back to one glDrawElements per visible run without
+// ARB_multi_draw_indirect / ARB_buffer_storage.
+class chunkDrawer {
+public:
+	// passCount: number of culled draws per frame (camera + shadow passes)
+	void init(const std::vector<MeshChunk> & chunks, const int passCount);
+
+	// Wait until the GPU has finished with this frame's command slot
+	void beginFrame();
+
+	// Cull against MVP and draw visible chunks.
+	// Expects the VAO, vertex attributes and element buffer to be bound.
+	// Returns the number of drawn chunks.
+	unsigned int draw(const int pass, const glm::mat4 & MVP);
+
+	// Same for a layered pass: a chunk is drawn if it is inside any
+	// of the mvpCount frusta (e.g. all lights of the shadow map array).
+	unsigned int draw(const int pass, const glm::mat4 * MVPs, const int mvpCount);
+
+	// Fence this frame's command slot
+	void endFrame();
+
+	void release();
+
+	bool usesIndirect() const { return indirect; }
+
+private:
+	// Frames in flight sharing the mapped buffer
+	static const int RING_SIZE = 3;
+
+	std::vector<MeshChunk> chunks;
+	int passCount = 0;
+	int frame = 0;
+	bool indirect = false;
+
+	GLuint indirectBuffer = 0;
+	// Persistently mapped for writing only
+	DrawElementsIndirectCommand * mapped = nullptr;
+
+	// Scratch of draw, kept to avoid allocating every pass
+	std::vector<glm::vec4> planes;
+	std::vector<DrawElementsIndirectCommand> commands;
+	GLsync fences[RING_SIZE] = { 0 };
+};
+
+#endif // MESHCHUNKS_HPP
@@ -0,0 +1,376 @@
+// Include standard liabraries
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <climits>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "getImageData.hpp"
+#include "dcmToModel.hpp"
+#include "volumePyramid.hpp"
+#include "taskScheduler.hpp"
+#include "meshLoader.hpp"
+
+meshLoader::~meshLoader() {
+	cancel();
+	wait();
+}
+
+void meshLoader::start(const char* path, const uint8_t iso, const uint8_t threshold) {
+	wait();
+	this->path = path;
+	this->iso = iso;
+	this->threshold = threshold;
+
+	raw.clear();
+	volumeReady = false;
+	pyramid.clear();
+	decodedSlices.clear();
+	filterRunning = false;
+	filteredSlices = 0;
+	slabsStarted = 0;
+	previewStarted = false;
+	pieces.clear();
+	finished.clear();
+	previewLevel = nullptr;
+	preview.clear();
+	previewPieces.clear();
+	previewReady = false;
+	cancelled = false;
+	stage = LOAD_DECODING;
+	worker = std::thread(&meshLoader::run, this);
+}
+
+void meshLoader::cancel() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		cancelled = true;
+	}
+	// The decoder may wait for space in the queue
+	queueSpace.notify_all();
+}
+
+void meshLoader::wait() {
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+float meshLoader::getProgress() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (pieces.empty()) {
+		return 0.0f;
+	}
+	return float(finished.size()) / pieces.size();
+}
+
+bool meshLoader::getVolumeInfo(
+	unsigned int dims[3],
+	int & rescale_intercept,
+	unsigned short & rescale_slope
+) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!volumeReady) {
+		return false;
+	}
+	dims[0] = this->dims[0];
+	dims[1] = this->dims[1];
+	dims[2] = this->dims[2];
+	rescale_intercept = this->rescale_intercept;
+	rescale_slope = this->rescale_slope;
+	return true;
+}
+
+size_t meshLoader::getSlabCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return pieces.size();
+}
+
+bool meshLoader::hasPreview() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return previewReady;
+}
+
+const MeshPiece & meshLoader::getPreviewPiece(const size_t slab) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return previewPieces[slab];
+}
+
+size_t meshLoader::getPieceCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return finished.size();
+}
+
+const MeshPiece & meshLoader::getPiece(const size_t index) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return pieces[finished[index]];
+}
+
+size_t meshLoader::getPieceSlab(const size_t index) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return finished[index];
+}
+
+void meshLoader::takeMesh(
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec3> & normals,
+	std::vector<uint8_t> & values,
+	std::vector<unsigned int> & faces
+) {
+	wait();
+	vertices.clear();
+	normals.clear();
+	values.clear();
+	faces.clear();
+
+	// Every slab indexes its own vertices, the whole mesh is drawn with
+	// 32-bit indices: it ends before the first slab that does not fit
+	size_t vertexCount = 0;
+	size_t faceCount = 0;
+	size_t pieceCount = 0;
+	for (auto const & piece : pieces) {
+		if (vertexCount + piece.vertices.size() > UINT_MAX || faceCount + piece.faces.size() > UINT_MAX) {
+			printf("Mesh too big for 32-bit indices, %zu of %zu slabs are used\n", pieceCount, pieces.size());
+			break;
+		}
+		vertexCount += piece.vertices.size();
+		faceCount += piece.faces.size();
+		pieceCount++;
+	}
+	vertices.reserve(vertexCount);
+	normals.reserve(vertexCount);
+	values.reserve(vertexCount);
+	faces.reserve(faceCount);
+
+	// Slabs in z order, as the faces of a single run
+	for (size_t i = 0; i < pieceCount; i++) {
+		MeshPiece & piece = pieces[i];
+		unsigned int offset = (unsigned int)vertices.size();
+		vertices.insert(vertices.end(), piece.vertices.begin(), piece.vertices.end());
+		normals.insert(normals.end(), piece.normals.begin(), piece.normals.end());
+		values.insert(values.end(), piece.values.begin(), piece.values.end());
+		for (auto index : piece.faces) {
+			faces.push_back(index + offset);
+		}
+		piece = MeshPiece();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	pieces.clear();
+	finished.clear();
+	previewPieces.clear();
+	previewReady = false;
+}
+
+void meshLoader::run() {
+	taskScheduler & scheduler = taskScheduler::global();
+	unsigned int dimX = 0;
+	unsigned int dimY = 0;
+	unsigned int dimZ = 0;
+	int intercept = 0;
+	unsigned short slope = 0;
+
+	// Sets the volume info and the slabs, once the size is known
+	auto publishVolume = [&]() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (volumeReady) {
+			return;
+		}
+		dims[0] = dimX;
+		dims[1] = dimY;
+		dims[2] = dimZ;
+		rescale_intercept = intercept;
+		rescale_slope = slope;
+		volumeReady = true;
+		filter.init(dimX, dimY, dimZ, threshold);
+		pieces.resize((dimZ + SLAB_SIZE - 1) / SLAB_SIZE);
+	};
+
+	// Convert dcm files to raw file, handing every slice to the filter
+	getImageSlices(path.c_str(), raw, dimX, dimY, dimZ, intercept, slope, [&](unsigned int z) {
+		publishVolume();
+
+		// Bounded queue: wait for the filter to catch up
+		std::unique_lock<std::mutex> lock(mutex);
+		queueSpace.wait(lock, [&]() {
+			return decodedSlices.size() < QUEUE_SLICES || cancelled;
+		});
+		if (cancelled) {
+			return false;
+		}
+		decodedSlices.push_back(z);
+		if (!filterRunning) {
+			filterRunning = true;
+			scheduler.run(tasks, [this]() {
+				filterSlices();
+			});
+		}
+		return true;
+	});
+	publishVolume();
+	printf("%s", "Get image done.\n");
+
+	// Help with the filter, slab and preview tasks until all are done
+	int decoding = LOAD_DECODING;
+	stage.compare_exchange_strong(decoding, LOAD_FILTERING);
+	scheduler.wait(tasks);
+
+	// The mesh is complete, the volumes are not needed any more
+	std::vector<uint8_t>().swap(raw);
+	previewLevel = nullptr;
+	pyramid.clear();
+	if (cancelled) {
+		stage = LOAD_CANCELLED;
+		return;
+	}
+	printf("Computing surface done (%d slabs).\n", (int)pieces.size());
+	stage = LOAD_DONE;
+}
+
+void meshLoader::filterSlices() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!decodedSlices.empty() && !cancelled) {
+		unsigned int z = decodedSlices.front();
+		decodedSlices.pop_front();
+		lock.unlock();
+		queueSpace.notify_all();
+
+		// The slab tasks only read slices that are final
+		unsigned int finalSlices = filter.addSlice(raw, z);
+
+		lock.lock();
+		filteredSlices = finalSlices;
+		startSlabs();
+	}
+	filterRunning = false;
+}
+
+void meshLoader::startSlabs() {
+	taskScheduler & scheduler = taskScheduler::global();
+	// Slices the extraction reads beyond the slab
+	dcmToModel dcm2Model;
+	dcm2Model.setEngine(engine);
+	dcm2Model.setManifold(manifold);
+	unsigned int slicesAfter = dcm2Model.getSlicesAfter();
+	while (slabsStarted < pieces.size()) {
+		unsigned int needed = std::min((slabsStarted + 1) * SLAB_SIZE + slicesAfter, dims[2]);
+		if (filteredSlices < needed) {
+			break;
+		}
+		unsigned int slab = slabsStarted++;
+		scheduler.run(tasks, [this, slab]() {
+			extractSlab(slab);
+		});
+	}
+
+	if (filteredSlices == dims[2] && !previewStarted) {
+		previewStarted = true;
+		stage = LOAD_EXTRACTING;
+		// Pyramid, then the coarse slabs in parallel, then publish. Started
+		// last, so this worker takes the pyramid before the waiting slabs.
+		preview.assign(pieces.size(), MeshPiece());
+		taskHandle pyramidTask = scheduler.run(tasks, [this]() {
+			buildPyramid();
+		});
+		std::vector<taskHandle> coarseTasks;
+		for (unsigned int slab = 0; slab < preview.size(); slab++) {
+			coarseTasks.push_back(scheduler.run(tasks, [this, slab]() {
+				if (previewLevel && !cancelled) {
+					meshSlab(previewLevel, slab, preview[slab]);
+				}
+			}, { pyramidTask }));
+		}
+		scheduler.run(tasks, [this]() {
+			publishPreview();
+		}, coarseTasks);
+	}
+}
+
+void meshLoader::extractSlab(const unsigned int slab) {
+	if (cancelled) {
+		return;
+	}
+	// Only this task writes the piece until it is listed as finished
+	meshSlab(nullptr, slab, pieces[slab]);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	finished.push_back(slab);
+}
+
+void meshLoader::buildPyramid() {
+	if (cancelled) {
+		return;
+	}
+	buildVolumePyramid(raw, dims[0], dims[1], dims[2], PYRAMID_LEVELS, pyramid);
+	if (pyramid.empty()) {
+		return;
+	}
+
+	// Finest level within the voxel budget, or the coarsest one
+	previewLevel = &pyramid.back();
+	for (auto const & candidate : pyramid) {
+		if (size_t(candidate.dims[0]) * candidate.dims[1] * candidate.dims[2] <= PREVIEW_VOXELS) {
+			previewLevel = &candidate;
+			break;
+		}
+	}
+}
+
+void meshLoader::publishPreview() {
+	if (!previewLevel || cancelled) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	previewPieces.swap(preview);
+	previewReady = true;
+	printf("Preview surface done (%dx downsampled).\n", 1 << previewLevel->level);
+}
+
+void meshLoader::meshSlab(const VolumeLevel * level, const unsigned int slab, MeshPiece & piece) {
+	const std::vector<uint8_t> & volume = level ? level->data : raw;
+	const unsigned int * volumeDims = level ? level->dims : dims;
+	// Slices of the level per slab
+	unsigned int scale = level ? 1u << level->level : 1u;
+	unsigned int slabSize = SLAB_SIZE / scale;
+
+	dcmToModel dcm2Model;
+	dcm2Model.setEngine(engine);
+	// The coarse surface is replaced soon and needs no shared vertices.
+	// A quad soup saves dualmc its lookups, flyingEdges shares for less.
+	VertexSharing levelSharing = engine == ENGINE_DUALMC ? VERTICES_SOUP : VERTICES_SHARED;
+	dcm2Model.setVertexSharing(level ? levelSharing : sharing);
+	dcm2Model.setManifold(manifold);
+	dcm2Model.setMaxError(maxError);
+	dcm2Model.runSlab(
+		volume,
+		volumeDims[0],
+		volumeDims[1],
+		volumeDims[2],
+		iso,
+		slab * slabSize,
+		(slab + 1) * slabSize,
+		piece.vertices,
+		piece.normals,
+		piece.faces,
+		piece.values
+	);
+
+	if (level) {
+		// Level voxel centers to full resolution voxel coordinates
+		float offset = 0.5f * (scale - 1);
+		for (auto & vertex : piece.vertices) {
+			vertex = vertex * float(scale) + glm::vec3(offset);
+		}
+	}
+}
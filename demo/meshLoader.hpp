@@ -0,0 +1,165 @@
+#ifndef MESHLOADER_HPP
+#define MESHLOADER_HPP
+
+// Loading steps, in order. The stages overlap, this is the first one
+// that has not finished yet.
+enum LoadStage {
+	LOAD_DECODING,		// Reading the dcm files
+	LOAD_FILTERING,		// removeNoise
+	LOAD_EXTRACTING,	// dualmc slab by slab
+	LOAD_DONE,
+	LOAD_CANCELLED
+};
+
+// Surface of one slab, with vertex normals
+struct MeshPiece {
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec3> normals;
+	std::vector<uint8_t> values;
+	std::vector<unsigned int> faces;
+};
+
+// Loads the dcm files and extracts the surface in the background, so
+// the window stays responsive while the mesh is built.
+// The stages are a pipeline: decoded slices go through a bounded queue
+// to the noise filter, and as soon as the filtered slices cover a slab
+// of SLAB_SIZE slices (plus the slices the extraction reads beyond it, see
+// dcmToModel::getSlicesAfter) the slab is meshed. Filtering and meshing run as
+// tasks on the global taskScheduler while decoding goes on.
+// Finished slabs can be drawn while the others are extracted. Once the
+// whole volume is filtered, a coarse surface of every slab is extracted
+// from a downsampled level of the volume to fill the gaps.
+class meshLoader {
+public:
+	~meshLoader();
+
+	void start(const char* path, const uint8_t iso, const uint8_t threshold);
+
+	// Extraction engine of the slabs, for the next start
+	void setEngine(const ExtractionEngine engine) { this->engine = engine; }
+	// Vertex sharing of the full resolution slabs, for the next start.
+	// The coarse surface of dualmc is always a quad soup.
+	void setVertexSharing(const VertexSharing sharing) { this->sharing = sharing; }
+	// Manifold surface (dcmToModel::setManifold), for the next start
+	void setManifold(const bool manifold) { this->manifold = manifold; }
+	// Error bound of dual contouring (dcmToModel::setMaxError), for the next start
+	void setMaxError(const float maxError) { this->maxError = maxError; }
+
+	// Ask the stages to stop. The dcm files are read by one library
+	// call, a stop during that call happens after it returns.
+	void cancel();
+
+	// Wait until loading is done or cancelled
+	void wait();
+
+	LoadStage getStage() const { return (LoadStage)stage.load(); }
+
+	// Extracted fraction of the volume, 0 to 1
+	float getProgress() const;
+
+	// Volume size and rescale parameters, once decoded
+	bool getVolumeInfo(
+		unsigned int dims[3],
+		int & rescale_intercept,
+		unsigned short & rescale_slope
+	) const;
+
+	// Number of slabs, known with the volume info
+	size_t getSlabCount() const;
+
+	// Coarse surface of a slab in full resolution voxel coordinates,
+	// available once hasPreview returns true. Stays valid until takeMesh.
+	bool hasPreview() const;
+	const MeshPiece & getPreviewPiece(const size_t slab) const;
+
+	// Slabs finished so far, in the order they finished.
+	// A piece stays valid until takeMesh.
+	size_t getPieceCount() const;
+	const MeshPiece & getPiece(const size_t index) const;
+	size_t getPieceSlab(const size_t index) const;
+
+	// All slabs in one mesh, once the stage is LOAD_DONE.
+	// The pieces are released.
+	void takeMesh(
+		std::vector<glm::vec3> & vertices,
+		std::vector<glm::vec3> & normals,
+		std::vector<uint8_t> & values,
+		std::vector<unsigned int> & faces
+	);
+
+	static const unsigned int SLAB_SIZE = 32;
+	// Decoded slices waiting for the filter
+	static const unsigned int QUEUE_SLICES = 2 * SLAB_SIZE;
+	// 2x, 4x and 8x levels; SLAB_SIZE has to be a multiple of 2^PYRAMID_LEVELS
+	static const unsigned int PYRAMID_LEVELS = 3;
+	// The preview uses the finest level with at most this many voxels
+	static const size_t PREVIEW_VOXELS = 1 << 21;
+
+private:
+	// Decode stage, on the loader's own thread
+	void run();
+
+	// Filter stage: filter the queued slices in order and start the
+	// slabs they complete. One task at a time.
+	void filterSlices();
+
+	// Start the tasks of the slabs the filtered slices cover
+	// (mutex is held)
+	void startSlabs();
+
+	// Extract stage, one task per slab
+	void extractSlab(const unsigned int slab);
+
+	// Coarse surface, once the volume is filtered: a pyramid task, a task
+	// per coarse slab depending on it, and a task publishing them all
+	void buildPyramid();
+	void publishPreview();
+
+	// Mesh slab of level (nullptr: full resolution) into piece
+	void meshSlab(const VolumeLevel * level, const unsigned int slab, MeshPiece & piece);
+
+	std::string path;
+	uint8_t iso = 128;
+	uint8_t threshold = 0;
+	ExtractionEngine engine = ENGINE_DUALMC;
+	VertexSharing sharing = VERTICES_SHARED;
+	bool manifold = false;
+	float maxError = 0.1f;
+
+	std::thread worker;
+	std::atomic<int> stage{ LOAD_DONE };
+	std::atomic<bool> cancelled{ false };
+
+	// Set once decoding starts
+	std::vector<uint8_t> raw;
+	unsigned int dims[3] = { 0, 0, 0 };
+	int rescale_intercept = 0;
+	unsigned short rescale_slope = 0;
+	bool volumeReady = false;
+	std::vector<VolumeLevel> pyramid;
+
+	// Pipeline state
+	taskGroup tasks;
+	noiseFilter filter;
+	std::deque<unsigned int> decodedSlices;
+	std::condition_variable queueSpace;
+	bool filterRunning = false;
+	unsigned int filteredSlices = 0;
+	unsigned int slabsStarted = 0;
+	bool previewStarted = false;
+
+	// One piece per slab, and the slabs in the order they finished
+	std::vector<MeshPiece> pieces;
+	std::vector<size_t> finished;
+
+	// Coarse surface, one piece per slab, built in preview and moved to
+	// previewPieces when complete
+	const VolumeLevel * previewLevel = nullptr;
+	std::vector<MeshPiece> preview;
+	std::vector<MeshPiece> previewPieces;
+	bool previewReady = false;
+
+	mutable std::mutex mutex;
+};
+
+#endif // MESHLOADER_HPP
@@ -0,0 +1,174 @@
+// Include standard liabraries
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// SSE2, always available on x64
+#include <emmintrin.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "taskScheduler.hpp"
+#include "trilinear.hpp"
+#include "mprSlicer.hpp"
+
+void mprSlicer::init(const int width, const int height) {
+	this->width = width;
+	this->height = height;
+}
+
+void mprSlicer::setVolume(
+	const std::vector<uint8_t> & raw,
+	const unsigned int dimX,
+	const unsigned int dimY,
+	const unsigned int dimZ
+) {
+	this->raw = &raw;
+	dims[0] = dimX;
+	dims[1] = dimY;
+	dims[2] = dimZ;
+}
+
+SlicePlane mprSlicer::getPlane(const SliceOrientation orientation) const {
+	glm::vec3 extent(dims[0] - 1.0f, dims[1] - 1.0f, dims[2] - 1.0f);
+	SlicePlane plane;
+	plane.center = extent * 0.5f;
+	glm::vec2 size;
+	switch (orientation) {
+	case SLICE_AXIAL:
+		// Rows are stored bottom-up, so y runs against V
+		plane.axisU = glm::vec3(1, 0, 0);
+		plane.axisV = glm::vec3(0, -1, 0);
+		size = glm::vec2(extent.x, extent.y);
+		break;
+	case SLICE_CORONAL:
+		plane.axisU = glm::vec3(1, 0, 0);
+		plane.axisV = glm::vec3(0, 0, 1);
+		size = glm::vec2(extent.x, extent.z);
+		break;
+	default:
+		plane.axisU = glm::vec3(0, 1, 0);
+		plane.axisV = glm::vec3(0, 0, 1);
+		size = glm::vec2(extent.y, extent.z);
+		break;
+	}
+
+	// Pixel size that fits both directions
+	float pixelSize = std::max(size.x / width, size.y / height);
+	plane.axisU *= pixelSize;
+	plane.axisV *= pixelSize;
+	return plane;
+}
+
+void mprSlicer::render(
+	const SlicePlane & plane,
+	const float thickness,
+	const SlabMode mode,
+	std::vector<unsigned char> & image
+) {
+	image.resize(size_t(width) * height);
+	int sliceCount = std::max(1, int(thickness + 0.5f));
+
+	int blockCount = (height + ROW_BLOCK - 1) / ROW_BLOCK;
+	taskScheduler::global().parallelFor(0, blockCount, 1, [&](int begin, int end) {
+		for (int block = begin; block < end; block++) {
+			int rowBegin = block * ROW_BLOCK;
+			renderRows(rowBegin, std::min(rowBegin + ROW_BLOCK, height), plane, sliceCount, mode, &image[0]);
+		}
+	});
+}
+
+void mprSlicer::renderRows(
+	const int rowBegin,
+	const int rowEnd,
+	const SlicePlane & plane,
+	const int sliceCount,
+	const SlabMode mode,
+	unsigned char * image
+) const {
+	// Slab samples one voxel apart, centered on the plane
+	glm::vec3 normal = glm::normalize(glm::cross(plane.axisU, plane.axisV));
+	glm::vec3 firstSlice = normal * (-0.5f * (sliceCount - 1));
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	const __m128 uX = _mm_set1_ps(plane.axisU.x);
+	const __m128 uY = _mm_set1_ps(plane.axisU.y);
+	const __m128 uZ = _mm_set1_ps(plane.axisU.z);
+	const __m128 maxX = _mm_set1_ps(dims[0] - 1.0f);
+	const __m128 maxY = _mm_set1_ps(dims[1] - 1.0f);
+	const __m128 maxZ = _mm_set1_ps(dims[2] - 1.0f);
+	const __m128 hiX = _mm_set1_ps(dims[0] - 1.001f);
+	const __m128 hiY = _mm_set1_ps(dims[1] - 1.001f);
+	const __m128 hiZ = _mm_set1_ps(dims[2] - 1.001f);
+	const __m128 scale = _mm_set1_ps(mode == SLAB_AVERAGE ? 1.0f / sliceCount : 1.0f);
+	const __m128 initial = _mm_set1_ps(mode == SLAB_MINIP ? 255.0f : 0.0f);
+
+	for (int y = rowBegin; y < rowEnd; y++) {
+		glm::vec3 rowStart = plane.center
+			+ (0.5f - 0.5f * width) * plane.axisU
+			+ (y + 0.5f - 0.5f * height) * plane.axisV
+			+ firstSlice;
+		unsigned char * row = image + size_t(y) * width;
+
+		for (int x = 0; x < width; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane);
+			__m128 X = _mm_add_ps(_mm_set1_ps(rowStart.x), _mm_mul_ps(px, uX));
+			__m128 Y = _mm_add_ps(_mm_set1_ps(rowStart.y), _mm_mul_ps(px, uY));
+			__m128 Z = _mm_add_ps(_mm_set1_ps(rowStart.z), _mm_mul_ps(px, uZ));
+
+			__m128 result = initial;
+			for (int k = 0; k < sliceCount; k++) {
+				__m128 inside = _mm_and_ps(
+					_mm_and_ps(
+						_mm_and_ps(_mm_cmpge_ps(X, zero), _mm_cmple_ps(X, maxX)),
+						_mm_and_ps(_mm_cmpge_ps(Y, zero), _mm_cmple_ps(Y, maxY))),
+					_mm_and_ps(_mm_cmpge_ps(Z, zero), _mm_cmple_ps(Z, maxZ)));
+				__m128 S = zero;
+				if (_mm_movemask_ps(inside) != 0) {
+					S = sampleTrilinear4(
+						raw->data(), dims,
+						_mm_min_ps(_mm_max_ps(X, zero), hiX),
+						_mm_min_ps(_mm_max_ps(Y, zero), hiY),
+						_mm_min_ps(_mm_max_ps(Z, zero), hiZ));
+					S = _mm_and_ps(inside, S);
+				}
+
+				if (mode == SLAB_MIP) {
+					result = _mm_max_ps(result, S);
+				}
+				else if (mode == SLAB_MINIP) {
+					result = _mm_min_ps(result, S);
+				}
+				else {
+					result = _mm_add_ps(result, S);
+				}
+
+				X = _mm_add_ps(X, _mm_set1_ps(normal.x));
+				Y = _mm_add_ps(Y, _mm_set1_ps(normal.y));
+				Z = _mm_add_ps(Z, _mm_set1_ps(normal.z));
+			}
+
+			// Round and pack 4 floats to 4 bytes
+			__m128i value = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(result, scale), _mm_set1_ps(0.5f)));
+			value = _mm_packs_epi32(value, value);
+			value = _mm_packus_epi16(value, value);
+			int bytes = _mm_cvtsi128_si32(value);
+			if (x + 4 <= width) {
+				memcpy(row + x, &bytes, 4);
+			}
+			else {
+				memcpy(row + x, &bytes, width - x);
+			}
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef MPRSLICER_HPP
+#define MPRSLICER_HPP
+
+// How the samples across a thick slab are combined
+enum SlabMode {
+	SLAB_MIP,		// Maximum
+	SLAB_MINIP,		// Minimum
+	SLAB_AVERAGE	// Mean
+};
+
+// Standard planes through the volume
+enum SliceOrientation {
+	SLICE_AXIAL,	// x right, y down (as the dcm images)
+	SLICE_CORONAL,	// x right, z up
+	SLICE_SAGITTAL	// y right, z up
+};
+
+// Plane in voxel coordinates. Pixel (x, y) of the image samples
+// center + (x + 0.5 - width / 2) * axisU + (y + 0.5 - height / 2) * axisV,
+// so the axes also set the pixel size. Slabs extend along their cross
+// product.
+struct SlicePlane {
+	glm::vec3 center;
+	glm::vec3 axisU;
+	glm::vec3 axisV;
+};
+
+// Multi-planar reconstruction: resamples axial, coronal, sagittal or
+// oblique planes and thick slabs from the raw volume.
+// Rows of 4 pixels are interpolated with SSE, blocks of rows run as
+// tasks of the global taskScheduler.
+class mprSlicer {
+public:
+	void init(const int width, const int height);
+
+	// Volume with x fastest, as getImageData returns it. The vector is
+	// not copied and has to stay alive while rendering.
+	void setVolume(
+		const std::vector<uint8_t> & raw,
+		const unsigned int dimX,
+		const unsigned int dimY,
+		const unsigned int dimZ
+	);
+
+	// Plane through the volume center which fits the volume into the image
+	SlicePlane getPlane(const SliceOrientation orientation) const;
+
+	// Resample a plane into 8-bit gray rows, bottom-up (GL texture
+	// layout, no padding). thickness is the slab size in voxels, samples
+	// are one voxel apart; 1 or less is a single slice. Samples outside
+	// the volume are 0.
+	void render(
+		const SlicePlane & plane,
+		const float thickness,
+		const SlabMode mode,
+		std::vector<unsigned char> & image
+	);
+
+	// Rows per task
+	static const int ROW_BLOCK = 16;
+
+private:
+	void renderRows(
+		const int rowBegin,
+		const int rowEnd,
+		const SlicePlane & plane,
+		const int sliceCount,
+		const SlabMode mode,
+		unsigned char * image
+	) const;
+
+	int width = 0;
+	int height = 0;
+
+	const std::vector<uint8_t> * raw = nullptr;
+	int dims[3] = { 0, 0, 0 };
+};
+
+#endif // MPRSLICER_HPP
@@ -0,0 +1,81 @@
+// Include standard liabraries
+#include <stdio.h>
+
+// GLEW
+#include <GL/glew.h>
+
+#include "shader.hpp"
+#include "postProcess.hpp"
+
+bool postProcess::init(const int width, const int height) {
+	this->width = width;
+	this->height = height;
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	// Linear filtering, FXAA samples between texels along the edge
+	glGenTextures(1, &colorTexture);
+	glBindTexture(GL_TEXTURE_2D, colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+
+	// Depth is never sampled, a renderbuffer is enough
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete) {
+		printf("Post process framebuffer incomplete\n");
+		return false;
+	}
+
+	programID = LoadShaders("ScreenQuad.vertexshader", "FXAA.fragmentshader");
+	sceneTextureID = glGetUniformLocation(programID, "sceneTexture");
+	inverseSizeID = glGetUniformLocation(programID, "InverseSize");
+	return true;
+}
+
+void postProcess::begin() {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+}
+
+void postProcess::resolve(const bool antialias, const GLuint targetFramebuffer) {
+	if (!antialias) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+		return;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+	glViewport(0, 0, width, height);
+	glDisable(GL_DEPTH_TEST);
+
+	glUseProgram(programID);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, colorTexture);
+	glUniform1i(sceneTextureID, 0);
+	glUniform2f(inverseSizeID, 1.0f / width, 1.0f / height);
+
+	// Full-screen triangle from gl_VertexID, no attributes enabled
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glEnable(GL_DEPTH_TEST);
+}
+
+void postProcess::release() {
+	glDeleteProgram(programID);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	glDeleteTextures(1, &colorTexture);
+	glDeleteFramebuffers(1, &framebuffer);
+}
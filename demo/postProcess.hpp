@@ -0,0 +1,41 @@
+#ifndef POSTPROCESS_HPP
+#define POSTPROCESS_HPP
+
+// Anti-aliasing of the main pass
+enum AntiAliasing {
+	AA_NONE,	// Single sample, straight to the window
+	AA_MSAA,	// Multisampled default framebuffer
+	AA_FXAA		// Single sample offscreen target + FXAA resolve
+};
+
+// Single-sample offscreen target resolved to the window with one
+// full-screen FXAA pass. Much cheaper than shading and storing 16
+// samples per pixel, at the cost of a slightly softer image.
+class postProcess {
+public:
+	// Returns false if the framebuffer is incomplete
+	bool init(const int width, const int height);
+
+	// Bind the offscreen target; draw the scene after this
+	void begin();
+
+	// Resolve to the given framebuffer (0 is the window). Without
+	// antialias the target is only copied (e.g. while the user interacts).
+	void resolve(const bool antialias, const GLuint targetFramebuffer = 0);
+
+	void release();
+
+private:
+	int width = 0;
+	int height = 0;
+
+	GLuint framebuffer = 0;
+	GLuint colorTexture = 0;
+	GLuint depthBuffer = 0;
+
+	GLuint programID = 0;
+	GLuint sceneTextureID = 0;
+	GLuint inverseSizeID = 0;
+};
+
+#endif // POSTPROCESS_HPP
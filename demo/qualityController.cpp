@@ -0,0 +1,92 @@
+// Include standard liabraries
+#include <algorithm>
+
+// GLEW
+#include <GL/glew.h>
+
+#include "qualityController.hpp"
+
+// From cheapest to full quality
+const QualitySettings qualityController::LEVELS[qualityController::LEVEL_COUNT] = {
+	{ true, 0, false },		// LOD mesh, no shadows, single sample
+	{ true, 1, false },		// LOD mesh, 1 shadow tap
+	{ false, 1, true },		// Full mesh, 1 shadow tap, anti-aliased
+	{ false, 4, true }		// Full quality
+};
+
+void qualityController::init(const double budgetMs) {
+	this->budgetMs = budgetMs;
+	averageMs = 0.0;
+	interactionLevel = 1;
+	level = LEVEL_COUNT - 1;
+	glGenQueries(2, queries);
+}
+
+void qualityController::beginFrame(const bool interacting, const double now) {
+	// Collect the GPU time of the previous frame if it is available
+	int previous = 1 - queryIndex;
+	if (queryPending[previous]) {
+		GLint available = 0;
+		glGetQueryObjectiv(queries[previous], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(queries[previous], GL_QUERY_RESULT, &elapsed);
+			gpuMs = elapsed / 1.0e6;
+			queryPending[previous] = false;
+		}
+	}
+
+	this->interacting = interacting;
+	if (interacting) {
+		lastInteraction = now;
+		level = interactionLevel;
+	}
+	else if (now - lastInteraction >= REFINE_DELAY && level < LEVEL_COUNT - 1) {
+		// Progressive refinement, one level per frame
+		level++;
+	}
+
+	if (!queryPending[queryIndex]) {
+		glBeginQuery(GL_TIME_ELAPSED, queries[queryIndex]);
+	}
+}
+
+void qualityController::endFrame(const double cpuMs) {
+	if (!queryPending[queryIndex]) {
+		glEndQuery(GL_TIME_ELAPSED);
+		queryPending[queryIndex] = true;
+	}
+	queryIndex = 1 - queryIndex;
+
+	if (!interacting) {
+		return;
+	}
+
+	// Track the interactive frame time and keep it inside the budget
+	double frameMs = std::max(cpuMs, gpuMs);
+	averageMs = averageMs == 0.0 ? frameMs : 0.8 * averageMs + 0.2 * frameMs;
+	if (averageMs > budgetMs && interactionLevel > 0) {
+		interactionLevel--;
+		averageMs = 0.0;
+	}
+	else if (averageMs < 0.5 * budgetMs && interactionLevel < LEVEL_COUNT - 1) {
+		interactionLevel++;
+		averageMs = 0.0;
+	}
+}
+
+QualitySettings qualityController::getSettings() const {
+	return LEVELS[level];
+}
+
+QualitySettings qualityController::getBestSettings() {
+	return LEVELS[LEVEL_COUNT - 1];
+}
+
+bool qualityController::isRefining() const {
+	return !interacting && level < LEVEL_COUNT - 1;
+}
+
+void qualityController::release() {
+	glDeleteQueries(2, queries);
+}
@@ -0,0 +1,60 @@
+#ifndef QUALITYCONTROLLER_HPP
+#define QUALITYCONTROLLER_HPP
+
+// Render settings of one quality level
+struct QualitySettings {
+	bool coarseMesh;	// Draw the clustered LOD instead of the full mesh
+	int shadowTaps;		// PCF taps per light, 0 disables shadows
+	bool antialias;		// MSAA or FXAA resolve, whichever is selected
+};
+
+// Picks a quality level per frame.
+// While the user interacts it drops to a cheap level which adapts to
+// the frame time budget, once input stops it refines one level per
+// frame up to full quality.
+class qualityController {
+public:
+	// Frame time budget in milliseconds
+	void init(const double budgetMs);
+
+	// Choose this frame's level and start timing it on the GPU
+	void beginFrame(const bool interacting, const double now);
+
+	// Stop timing; CPU time of the frame in milliseconds
+	void endFrame(const double cpuMs);
+
+	QualitySettings getSettings() const;
+
+	// Full quality, e.g. for offline rendering
+	static QualitySettings getBestSettings();
+
+	// True while the level is below full quality and no input is
+	// coming, i.e. more frames are needed to refine the image
+	bool isRefining() const;
+
+	void release();
+
+	// Time without input before refinement starts (seconds)
+	static constexpr double REFINE_DELAY = 0.15;
+
+private:
+	static const int LEVEL_COUNT = 4;
+	static const QualitySettings LEVELS[LEVEL_COUNT];
+
+	double budgetMs = 16.7;
+	// Exponential moving average of the interactive frame time
+	double averageMs = 0.0;
+	// Best level which kept the budget while interacting
+	int interactionLevel = 1;
+	int level = LEVEL_COUNT - 1;
+	bool interacting = false;
+	double lastInteraction = 0.0;
+
+	// GPU timer queries, read one frame late so nothing stalls
+	GLuint queries[2] = { 0, 0 };
+	bool queryPending[2] = { false, false };
+	int queryIndex = 0;
+	double gpuMs = 0.0;
+};
+
+#endif // QUALITYCONTROLLER_HPP
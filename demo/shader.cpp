@@ -16,6 +16,7 @@ using namespace std;
  * This shader load cpp file is completely copied from:
  * http://www.opengl-tutorial.org/
  * I do not make any changes.
+ * (The overload with a geometry stage and defines at the end is ours.)
  */
 
 GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_path) {
@@ -110,4 +111,84 @@ GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_pat
 	glDeleteShader(FragmentShaderID);
 
 	return ProgramID;
-}
\ No newline at end of file
+}
+// Read a shader file and insert defines right after its #version line
+static GLuint compileShaderFile(GLenum type, const char * file_path, const char * defines) {
+	std::string ShaderCode;
+	std::ifstream ShaderStream(file_path, std::ios::in);
+	if (ShaderStream.is_open()) {
+		std::stringstream sstr;
+		sstr << ShaderStream.rdbuf();
+		ShaderCode = sstr.str();
+		ShaderStream.close();
+	}
+	else {
+		printf("Impossible to open %s. Are you in the right directory ?\n", file_path);
+		return 0;
+	}
+	if (defines != NULL) {
+		size_t versionEnd = ShaderCode.find('\n') + 1;
+		ShaderCode.insert(versionEnd, defines);
+	}
+
+	printf("Compiling shader : %s\n", file_path);
+	GLuint ShaderID = glCreateShader(type);
+	char const * SourcePointer = ShaderCode.c_str();
+	glShaderSource(ShaderID, 1, &SourcePointer, NULL);
+	glCompileShader(ShaderID);
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+	glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if (InfoLogLength > 0) {
+		std::vector<char> ShaderErrorMessage(InfoLogLength + 1);
+		glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		printf("%s\n", &ShaderErrorMessage[0]);
+	}
+	return ShaderID;
+}
+
+GLuint LoadShaders(
+	const char * vertex_file_path,
+	const char * geometry_file_path,
+	const char * fragment_file_path,
+	const char * defines
+) {
+	GLuint ShaderIDs[3] = {
+		compileShaderFile(GL_VERTEX_SHADER, vertex_file_path, defines),
+		geometry_file_path == NULL ? 0
+			: compileShaderFile(GL_GEOMETRY_SHADER, geometry_file_path, defines),
+		compileShaderFile(GL_FRAGMENT_SHADER, fragment_file_path, defines)
+	};
+
+	// Link the program
+	printf("Linking program\n");
+	GLuint ProgramID = glCreateProgram();
+	for (GLuint ShaderID : ShaderIDs) {
+		if (ShaderID != 0) {
+			glAttachShader(ProgramID, ShaderID);
+		}
+	}
+	glLinkProgram(ProgramID);
+
+	// Check the program
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if (InfoLogLength > 0) {
+		std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
+		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		printf("%s\n", &ProgramErrorMessage[0]);
+	}
+
+	for (GLuint ShaderID : ShaderIDs) {
+		if (ShaderID != 0) {
+			glDetachShader(ProgramID, ShaderID);
+			glDeleteShader(ShaderID);
+		}
+	}
+
+	return ProgramID;
+}
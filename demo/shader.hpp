@@ -3,4 +3,13 @@
 
 GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_path);
 
+// Optional geometry stage (NULL to skip).
+// defines (e.g. "#define LIGHT_COUNT 3\n") are inserted after #version.
+GLuint LoadShaders(
+	const char * vertex_file_path,
+	const char * geometry_file_path,
+	const char * fragment_file_path,
+	const char * defines
+);
+
 #endif // SHADER_HPP
@@ -0,0 +1,368 @@
+// Include standard liabraries
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <climits>
+#include <cmath>
+
+// SSE2, always available on x64
+#include <emmintrin.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "taskScheduler.hpp"
+#include "softwareRasterizer.hpp"
+
+// Triangle id of pixels no triangle covers
+static const unsigned int NO_TRIANGLE = UINT_MAX;
+
+// Vertices transformed per task
+static const size_t VERTEX_BLOCK = 16384;
+
+glm::vec3 shadePhong(
+	const glm::vec3 & material,
+	const glm::vec3 & position,
+	const glm::vec3 & normal,
+	const glm::vec3 * lightsCamera,
+	const float * lightPowers,
+	const size_t lightCount
+) {
+	glm::vec3 n = glm::normalize(normal);
+	glm::vec3 v = glm::normalize(-position);
+	glm::vec3 color(0.3f * 0.7f);
+	for (size_t i = 0; i < lightCount; i++) {
+		glm::vec3 toLight = lightsCamera[i] - position;
+		float distance = glm::length(toLight) / 2;
+		glm::vec3 l = toLight / (2 * distance);
+		float cosTheta = glm::clamp(glm::dot(n, l), 0.0f, 1.0f);
+		glm::vec3 r = glm::reflect(-l, n);
+		float cosAlpha = glm::clamp(glm::dot(v, r), 0.0f, 1.0f);
+		float cosAlpha2 = cosAlpha * cosAlpha;
+		float attenuation = 0.8f * lightPowers[i] / (distance * distance);
+		color += material * attenuation * cosTheta
+			+ glm::vec3(0.3f) * attenuation * cosAlpha2 * cosAlpha2 * cosAlpha;
+	}
+	return glm::clamp(color, 0.0f, 1.0f);
+}
+
+template <typename Function>
+void softwareRasterizer::runThreads(Function fn) {
+	taskScheduler::global().parallelFor(0, (int)threadCount, 1, [&](int begin, int end) {
+		for (int thread = begin; thread < end; thread++) {
+			fn((unsigned int)thread);
+		}
+	});
+}
+
+void softwareRasterizer::init(const int width, const int height, unsigned int threadCount) {
+	this->width = width;
+	this->height = height;
+	tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	if (threadCount == 0) {
+		threadCount = taskScheduler::global().getThreadCount();
+	}
+	this->threadCount = threadCount;
+
+	bins.assign(threadCount, std::vector<std::vector<unsigned int>>(tilesX * tilesY));
+}
+
+void softwareRasterizer::setMesh(
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<uint8_t> & values,
+	const std::vector<unsigned int> & faces
+) {
+	this->vertices = &vertices;
+	this->normals = &normals;
+	this->values = &values;
+	this->faces = &faces;
+}
+
+void softwareRasterizer::setTransferFunction(const std::vector<unsigned char> & rgb) {
+	transfer.resize(rgb.size() / 3);
+	for (size_t i = 0; i < transfer.size(); i++) {
+		transfer[i] = glm::vec3(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]) / 255.0f;
+	}
+}
+
+void softwareRasterizer::setLights(const std::vector<glm::vec3> & positions, const std::vector<float> & powers) {
+	lightPositions = positions;
+	lightPowers = powers;
+}
+
+void softwareRasterizer::render(
+	const glm::mat4 & ProjectionMatrix,
+	const glm::mat4 & ViewMatrix,
+	const glm::mat4 & ModelMatrix,
+	std::vector<unsigned char> & image
+) {
+	MV = ViewMatrix * ModelMatrix;
+	MVP = ProjectionMatrix * MV;
+	V = ViewMatrix;
+
+	screen.resize(vertices->size());
+	positionsCamera.resize(vertices->size());
+	normalsCamera.resize(vertices->size());
+	setups.resize(faces->size() / 3);
+	for (auto & threadBins : bins) {
+		for (auto & bin : threadBins) {
+			bin.clear();
+		}
+	}
+
+	// Vertices in blocks, then triangle setup and binning into the bins
+	// of each thread
+	int vertexBlocks = int((vertices->size() + VERTEX_BLOCK - 1) / VERTEX_BLOCK);
+	taskScheduler::global().parallelFor(0, vertexBlocks, 1, [this](int begin, int end) {
+		transformVertices(size_t(begin) * VERTEX_BLOCK, std::min(size_t(end) * VERTEX_BLOCK, vertices->size()));
+	});
+	runThreads([this](unsigned int thread) { setupTriangles(thread); });
+
+	// Rows padded to 4 bytes
+	image.resize(size_t((width * 3 + 3) & ~3) * height);
+	rasterizeTiles(image);
+}
+
+void softwareRasterizer::transformVertices(const size_t begin, const size_t end) {
+	for (size_t i = begin; i < end; i++) {
+		glm::vec4 position((*vertices)[i], 1.0f);
+		glm::vec4 clip = MVP * position;
+
+		// Viewport transform, y up like GL (rows are stored bottom-up)
+		ScreenVertex & s = screen[i];
+		s.invW = clip.w > 0.0f ? 1.0f / clip.w : 0.0f;
+		s.x = (clip.x * s.invW * 0.5f + 0.5f) * width;
+		s.y = (clip.y * s.invW * 0.5f + 0.5f) * height;
+		s.z = clip.z * s.invW * 0.5f + 0.5f;
+
+		positionsCamera[i] = glm::vec3(MV * position);
+		normalsCamera[i] = glm::vec3(MV * glm::vec4((*normals)[i], 0.0f));
+	}
+}
+
+void softwareRasterizer::setupTriangles(const unsigned int thread) {
+	size_t count = setups.size();
+	size_t begin = count * thread / threadCount;
+	size_t end = count * (thread + 1) / threadCount;
+	std::vector<std::vector<unsigned int>> & threadBins = bins[thread];
+
+	for (size_t t = begin; t < end; t++) {
+		const ScreenVertex & v0 = screen[(*faces)[3 * t]];
+		const ScreenVertex & v1 = screen[(*faces)[3 * t + 1]];
+		const ScreenVertex & v2 = screen[(*faces)[3 * t + 2]];
+
+		// No near plane clipping: triangles reaching behind the camera
+		// are dropped, the demo camera never gets that close
+		if (v0.invW == 0.0f || v1.invW == 0.0f || v2.invW == 0.0f) {
+			continue;
+		}
+
+		// Counter-clockwise triangles face the camera, cull the rest
+		float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+		if (area <= 0.0f) {
+			continue;
+		}
+
+		// Pixel centers inside the bounds, clamped to the screen
+		int minX = std::max(0, (int)std::ceil(std::min({ v0.x, v1.x, v2.x }) - 0.5f));
+		int minY = std::max(0, (int)std::ceil(std::min({ v0.y, v1.y, v2.y }) - 0.5f));
+		int maxX = std::min(width - 1, (int)std::floor(std::max({ v0.x, v1.x, v2.x }) - 0.5f));
+		int maxY = std::min(height - 1, (int)std::floor(std::max({ v0.y, v1.y, v2.y }) - 0.5f));
+		if (minX > maxX || minY > maxY) {
+			continue;
+		}
+
+		// Edge k is opposite to vertex k, positive inside and equal to
+		// the doubled area on vertex k. It is evaluated relative to one of
+		// its end points to keep small triangles far from the origin
+		// precise. A shared edge is always set up from its lower vertex
+		// index, so both triangles get exactly negated values and no
+		// pixel on it is missed by both.
+		TriangleSetup & setup = setups[t];
+		const ScreenVertex * corner[3] = { &v0, &v1, &v2 };
+		setup.invArea = 1.0f / area;
+		setup.zA = setup.zB = 0.0f;
+		for (int k = 0; k < 3; k++) {
+			int ia = (k + 1) % 3;
+			int ib = (k + 2) % 3;
+			bool flip = (*faces)[3 * t + ia] > (*faces)[3 * t + ib];
+			const ScreenVertex & a = *corner[flip ? ib : ia];
+			const ScreenVertex & b = *corner[flip ? ia : ib];
+			float sign = flip ? -1.0f : 1.0f;
+			setup.edgeA[k] = sign * (a.y - b.y);
+			setup.edgeB[k] = sign * (b.x - a.x);
+			setup.originX[k] = a.x;
+			setup.originY[k] = a.y;
+			// Window depth is affine in screen space
+			setup.zA += corner[k]->z * setup.edgeA[k] * setup.invArea;
+			setup.zB += corner[k]->z * setup.edgeB[k] * setup.invArea;
+		}
+		setup.zC = v0.z - setup.zA * v0.x - setup.zB * v0.y;
+		setup.minX = minX;
+		setup.minY = minY;
+		setup.maxX = maxX;
+		setup.maxY = maxY;
+
+		// Bin into every tile the bounds overlap
+		for (int ty = minY / TILE_SIZE; ty <= maxY / TILE_SIZE; ty++) {
+			for (int tx = minX / TILE_SIZE; tx <= maxX / TILE_SIZE; tx++) {
+				threadBins[ty * tilesX + tx].push_back((unsigned int)t);
+			}
+		}
+	}
+}
+
+void softwareRasterizer::rasterizeTiles(std::vector<unsigned char> & image) {
+	int tileCount = tilesX * tilesY;
+
+	taskScheduler::global().parallelFor(0, tileCount, 1, [&](int begin, int end) {
+		// Tile-local depth and triangle id buffers, 16-byte aligned rows
+		alignas(16) float depth[TILE_SIZE * TILE_SIZE];
+		alignas(16) unsigned int triangleIds[TILE_SIZE * TILE_SIZE];
+		const __m128 pixelOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+
+		for (int tile = begin; tile < end; tile++) {
+			int tileX = (tile % tilesX) * TILE_SIZE;
+			int tileY = (tile / tilesX) * TILE_SIZE;
+			std::fill(depth, depth + TILE_SIZE * TILE_SIZE, 1.0f);
+			std::fill(triangleIds, triangleIds + TILE_SIZE * TILE_SIZE, NO_TRIANGLE);
+
+			for (auto const & threadBins : bins) {
+				for (unsigned int t : threadBins[tile]) {
+					const TriangleSetup & setup = setups[t];
+					// Start on a multiple of 4 inside the tile
+					int x0 = std::max(setup.minX, tileX);
+					x0 = tileX + ((x0 - tileX) & ~3);
+					int x1 = std::min(setup.maxX, tileX + TILE_SIZE - 1);
+					int y0 = std::max(setup.minY, tileY);
+					int y1 = std::min(setup.maxY, tileY + TILE_SIZE - 1);
+
+					const __m128 a0 = _mm_set1_ps(setup.edgeA[0]);
+					const __m128 a1 = _mm_set1_ps(setup.edgeA[1]);
+					const __m128 a2 = _mm_set1_ps(setup.edgeA[2]);
+					const __m128 ox0 = _mm_set1_ps(setup.originX[0]);
+					const __m128 ox1 = _mm_set1_ps(setup.originX[1]);
+					const __m128 ox2 = _mm_set1_ps(setup.originX[2]);
+					const __m128 az = _mm_set1_ps(setup.zA);
+					const __m128i id = _mm_set1_epi32((int)t);
+
+					for (int y = y0; y <= y1; y++) {
+						float py = y + 0.5f;
+						const __m128 row0 = _mm_set1_ps(setup.edgeB[0] * (py - setup.originY[0]));
+						const __m128 row1 = _mm_set1_ps(setup.edgeB[1] * (py - setup.originY[1]));
+						const __m128 row2 = _mm_set1_ps(setup.edgeB[2] * (py - setup.originY[2]));
+						const __m128 rowZ = _mm_set1_ps(setup.zB * py + setup.zC);
+						float * depthRow = depth + (y - tileY) * TILE_SIZE - tileX;
+						unsigned int * idRow = triangleIds + (y - tileY) * TILE_SIZE - tileX;
+
+						for (int x = x0; x <= x1; x += 4) {
+							__m128 px = _mm_add_ps(_mm_set1_ps((float)x), pixelOffset);
+							// Inside all three edges (shared edges may be hit
+							// twice, the depth test makes that harmless)
+							__m128 inside = _mm_and_ps(
+								_mm_and_ps(
+									_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_sub_ps(px, ox0)), row0), zero),
+									_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, _mm_sub_ps(px, ox1)), row1), zero)),
+								_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, _mm_sub_ps(px, ox2)), row2), zero));
+							if (_mm_movemask_ps(inside) == 0) {
+								continue;
+							}
+
+							// Depth test, GL_LESS, in front of the near plane
+							__m128 z = _mm_add_ps(_mm_mul_ps(az, px), rowZ);
+							__m128 oldZ = _mm_load_ps(depthRow + x);
+							__m128 pass = _mm_and_ps(inside,
+								_mm_and_ps(_mm_cmplt_ps(z, oldZ), _mm_cmpge_ps(z, zero)));
+							if (_mm_movemask_ps(pass) == 0) {
+								continue;
+							}
+							_mm_store_ps(depthRow + x,
+								_mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, oldZ)));
+							__m128i passI = _mm_castps_si128(pass);
+							__m128i oldId = _mm_load_si128((const __m128i *)(idRow + x));
+							_mm_store_si128((__m128i *)(idRow + x),
+								_mm_or_si128(_mm_and_si128(passI, id), _mm_andnot_si128(passI, oldId)));
+						}
+					}
+				}
+			}
+
+			shadeTile(tileX, tileY, triangleIds, image);
+		}
+	});
+}
+
+void softwareRasterizer::shadeTile(
+	const int tileX,
+	const int tileY,
+	const unsigned int * triangleIds,
+	std::vector<unsigned char> & image
+) const {
+	size_t rowSize = (width * 3 + 3) & ~3;
+	// Same background as glClearColor in demo.cpp
+	const unsigned char background = (unsigned char)(0.467f * 255.0f + 0.5f);
+
+	// Lights in camera space
+	std::vector<glm::vec3> lightsCamera(lightPositions.size());
+	for (size_t i = 0; i < lightPositions.size(); i++) {
+		lightsCamera[i] = glm::vec3(V * glm::vec4(lightPositions[i], 1.0f));
+	}
+
+	int xEnd = std::min(tileX + TILE_SIZE, width);
+	int yEnd = std::min(tileY + TILE_SIZE, height);
+	for (int y = tileY; y < yEnd; y++) {
+		unsigned char * pixel = &image[y * rowSize + tileX * 3];
+		for (int x = tileX; x < xEnd; x++, pixel += 3) {
+			unsigned int t = triangleIds[(y - tileY) * TILE_SIZE + (x - tileX)];
+			if (t == NO_TRIANGLE) {
+				pixel[0] = pixel[1] = pixel[2] = background;
+				continue;
+			}
+
+			// Perspective correct barycentric weights at the pixel center
+			const TriangleSetup & setup = setups[t];
+			float px = x + 0.5f;
+			float py = y + 0.5f;
+			unsigned int index[3];
+			float weight[3];
+			float weightSum = 0.0f;
+			for (int k = 0; k < 3; k++) {
+				index[k] = (*faces)[3 * t + k];
+				float lambda = (setup.edgeA[k] * (px - setup.originX[k])
+					+ setup.edgeB[k] * (py - setup.originY[k])) * setup.invArea;
+				weight[k] = std::max(lambda, 0.0f) * screen[index[k]].invW;
+				weightSum += weight[k];
+			}
+			glm::vec3 position(0.0f);
+			glm::vec3 normal(0.0f);
+			float value = 0.0f;
+			for (int k = 0; k < 3; k++) {
+				float w = weight[k] / weightSum;
+				position += w * positionsCamera[index[k]];
+				normal += w * normalsCamera[index[k]];
+				value += w * (*values)[index[k]];
+			}
+
+			glm::vec3 material = transfer[std::min((int)transfer.size() - 1, (int)(value + 0.5f))];
+			glm::vec3 color = shadePhong(material, position, normal,
+				lightsCamera.data(), lightPowers.data(), lightsCamera.size());
+
+			// BGR like GL_BGR readback
+			color = color * 255.0f + 0.5f;
+			pixel[0] = (unsigned char)color.b;
+			pixel[1] = (unsigned char)color.g;
+			pixel[2] = (unsigned char)color.r;
+		}
+	}
+}
@@ -0,0 +1,122 @@
+#ifndef SOFTWARERASTERIZER_HPP
+#define SOFTWARERASTERIZER_HPP
+
+// CPU renderer for machines without any GL implementation.
+// Triangles are set up and binned into screen tiles in parallel, then
+// every tile is rasterized by one thread (4 pixels per step with SSE)
+// into a tile-local depth and triangle id buffer, and each visible
+// pixel is shaded once with the Phong model of fShader (no shadows).
+// Phong model of fShader without shadows (visibility 1), in camera
+// space. Returns the clamped color; normal does not need to be unit.
+glm::vec3 shadePhong(
+	const glm::vec3 & material,
+	const glm::vec3 & position,
+	const glm::vec3 & normal,
+	const glm::vec3 * lightsCamera,
+	const float * lightPowers,
+	const size_t lightCount
+);
+
+class softwareRasterizer {
+public:
+	// threadCount parts of the work run in parallel, 0 uses one per
+	// thread of the global taskScheduler
+	void init(const int width, const int height, unsigned int threadCount);
+
+	// Mesh in model space. The vectors are not copied and have to
+	// stay alive while rendering.
+	void setMesh(
+		const std::vector<glm::vec3> & vertices,
+		const std::vector<glm::vec3> & normals,
+		const std::vector<uint8_t> & values,
+		const std::vector<unsigned int> & faces
+	);
+
+	// Tissue colors, see buildTransferFunction
+	void setTransferFunction(const std::vector<unsigned char> & rgb);
+
+	// Point lights in world space with power as in fShader
+	void setLights(const std::vector<glm::vec3> & positions, const std::vector<float> & powers);
+
+	// Render one frame into BGR rows, bottom-up and padded to 4 bytes
+	// (the layout saveBMP writes)
+	void render(
+		const glm::mat4 & ProjectionMatrix,
+		const glm::mat4 & ViewMatrix,
+		const glm::mat4 & ModelMatrix,
+		std::vector<unsigned char> & image
+	);
+
+	// Tiles are TILE_SIZE^2 pixels, a multiple of the SIMD width
+	static const int TILE_SIZE = 64;
+
+private:
+	// Window position of a vertex, z in [0, 1]
+	struct ScreenVertex {
+		float x;
+		float y;
+		float z;
+		float invW;
+	};
+
+	// Edge functions A * (x - originX) + B * (y - originY) (times
+	// invArea the barycentric weight of the opposite vertex) and the
+	// depth plane
+	struct TriangleSetup {
+		float edgeA[3];
+		float edgeB[3];
+		float originX[3];
+		float originY[3];
+		float invArea;
+		float zA;
+		float zB;
+		float zC;
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+	};
+
+	void transformVertices(const size_t begin, const size_t end);
+	void setupTriangles(const unsigned int thread);
+	void rasterizeTiles(std::vector<unsigned char> & image);
+	void shadeTile(
+		const int tileX,
+		const int tileY,
+		const unsigned int * triangleIds,
+		std::vector<unsigned char> & image
+	) const;
+
+	// Run fn(thread) for every part as tasks of the global taskScheduler
+	// and wait, for work that fills per thread state (bins)
+	template <typename Function>
+	void runThreads(Function fn);
+
+	int width = 0;
+	int height = 0;
+	int tilesX = 0;
+	int tilesY = 0;
+	unsigned int threadCount = 1;
+
+	const std::vector<glm::vec3> * vertices = nullptr;
+	const std::vector<glm::vec3> * normals = nullptr;
+	const std::vector<uint8_t> * values = nullptr;
+	const std::vector<unsigned int> * faces = nullptr;
+
+	std::vector<glm::vec3> transfer;
+	std::vector<glm::vec3> lightPositions;
+	std::vector<float> lightPowers;
+
+	// Per frame state
+	glm::mat4 MVP;
+	glm::mat4 MV;
+	glm::mat4 V;
+	std::vector<ScreenVertex> screen;
+	std::vector<glm::vec3> positionsCamera;
+	std::vector<glm::vec3> normalsCamera;
+	std::vector<TriangleSetup> setups;
+	// Triangle ids per tile, one list per thread that binned them
+	std::vector<std::vector<std::vector<unsigned int>>> bins;
+};
+
+#endif // SOFTWARERASTERIZER_HPP
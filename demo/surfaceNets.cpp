@@ -0,0 +1,275 @@
+// Include standard liabraries
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+// SSE2, always available on x64
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Dual mc tables
+#include "dualmc.h"
+
+#include "surfaceNets.hpp"
+
+// Index of the lowest set bit, bits must not be 0
+static inline int surfaceNetsLowestBit(const unsigned int bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctz(bits);
+#endif
+}
+
+// 0xff for the 16 voxels >= iso
+static inline __m128i surfaceNetsInside(const uint8_t * voxels, const __m128i isoValue) {
+	__m128i values = _mm_loadu_si128((const __m128i*)voxels);
+	return _mm_cmpeq_epi8(_mm_max_epu8(values, isoValue), values);
+}
+
+void surfaceNets::build(
+	const uint8_t * data,
+	const int32_t dimX,
+	const int32_t dimY,
+	const int32_t dimZ,
+	const uint8_t iso,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors
+) {
+	this->data = data;
+	dims[0] = dimX;
+	dims[1] = dimY;
+	dims[2] = dimZ;
+	this->iso = iso;
+	extract(0, dimZ - 2, vertices, quads, colors, nullptr);
+}
+
+void surfaceNets::buildSlab(
+	const uint8_t * data,
+	const int32_t dimX,
+	const int32_t dimY,
+	const int32_t dimZ,
+	const uint8_t iso,
+	const int32_t zBegin,
+	const int32_t zEnd,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors,
+	std::vector<size_t> & sliceQuads
+) {
+	this->data = data;
+	dims[0] = dimX;
+	dims[1] = dimY;
+	dims[2] = dimZ;
+	this->iso = iso;
+	sliceQuads.clear();
+	extract(zBegin, zEnd, vertices, quads, colors, &sliceQuads);
+}
+
+void surfaceNets::extract(
+	const int32_t zBegin,
+	const int32_t zEnd,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors,
+	std::vector<size_t> * sliceQuads
+) {
+	int32_t reducedX = dims[0] - 2;
+	int32_t reducedY = dims[1] - 2;
+
+	// Same range as dualmc
+	int32_t zFirst = std::max(zBegin, 0);
+	int32_t zLast = std::min(zEnd, dims[2] - 2);
+	vertices.clear();
+	quads.clear();
+	colors.clear();
+	if (reducedX <= 0 || reducedY <= 0 || zFirst >= zLast) {
+		if (sliceQuads) {
+			sliceQuads->push_back(0);
+		}
+		return;
+	}
+
+	size_t rowSize = dims[0];
+	size_t sliceSize = rowSize * dims[1];
+	for (int edge = 0; edge < 12; edge++) {
+		const int32_t * corner = dualmc::edgeStart[edge];
+		int axis = dualmc::edgeAxis[edge];
+		edgeOffsets[edge] = corner[0] + rowSize * corner[1] + sliceSize * corner[2];
+		edgeSteps[edge] = axis == 0 ? 1 : axis == 1 ? rowSize : sliceSize;
+	}
+	size_t sliceCells = size_t(reducedX) * reducedY;
+	slotIndices[0].resize(sliceCells);
+	slotIndices[1].resize(sliceCells);
+	codes.assign((reducedX + 15) / 16 * 16, 0);
+
+	// The quads of the first edge slice use the cells below it
+	if (zFirst > 0) {
+		extractSlice(zFirst - 1, false, vertices, quads, colors);
+	}
+	for (int32_t z = zFirst; z < zLast; z++) {
+		if (sliceQuads) {
+			sliceQuads->push_back(quads.size());
+		}
+		extractSlice(z, true, vertices, quads, colors);
+	}
+	if (sliceQuads) {
+		sliceQuads->push_back(quads.size());
+	}
+}
+
+void surfaceNets::classifyRow(const int32_t y, const int32_t z, uint8_t * codes) const {
+	size_t rowSize = dims[0];
+	size_t sliceSize = rowSize * dims[1];
+	const uint8_t * row00 = data + (size_t(z) * dims[1] + y) * rowSize;
+	const uint8_t * row10 = row00 + rowSize;
+	const uint8_t * row01 = row00 + sliceSize;
+	const uint8_t * row11 = row01 + rowSize;
+	int32_t reducedX = dims[0] - 2;
+
+	// Corner bits as in dualmc::getCellCode, 16 cells per step
+	const __m128i isoValue = _mm_set1_epi8((char)iso);
+	int32_t x = 0;
+	for (; x + 16 <= reducedX; x += 16) {
+		__m128i code = _mm_and_si128(surfaceNetsInside(row00 + x, isoValue), _mm_set1_epi8(1));
+		code = _mm_or_si128(code, _mm_and_si128(surfaceNetsInside(row00 + x + 1, isoValue), _mm_set1_epi8(2)));
+		code = _mm_or_si128(code, _mm_and_si128(surfaceNetsInside(row10 + x, isoValue), _mm_set1_epi8(4)));
+		code = _mm_or_si128(code, _mm_and_si128(surfaceNetsInside(row10 + x + 1, isoValue), _mm_set1_epi8(8)));
+		code = _mm_or_si128(code, _mm_and_si128(surfaceNetsInside(row01 + x, isoValue), _mm_set1_epi8(16)));
+		code = _mm_or_si128(code, _mm_and_si128(surfaceNetsInside(row01 + x + 1, isoValue), _mm_set1_epi8(32)));
+		code = _mm_or_si128(code, _mm_and_si128(surfaceNetsInside(row11 + x, isoValue), _mm_set1_epi8(64)));
+		code = _mm_or_si128(code, _mm_and_si128(surfaceNetsInside(row11 + x + 1, isoValue), _mm_set1_epi8((char)128)));
+		_mm_storeu_si128((__m128i*)(codes + x), code);
+	}
+	for (; x < reducedX; x++) {
+		codes[x] = (uint8_t)((row00[x] >= iso) | (row00[x + 1] >= iso) << 1
+			| (row10[x] >= iso) << 2 | (row10[x + 1] >= iso) << 3
+			| (row01[x] >= iso) << 4 | (row01[x + 1] >= iso) << 5
+			| (row11[x] >= iso) << 6 | (row11[x + 1] >= iso) << 7);
+	}
+}
+
+void surfaceNets::extractSlice(
+	const int32_t z,
+	const bool quads,
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quadList,
+	std::vector<uint8_t> & colors
+) {
+	int32_t reducedX = dims[0] - 2;
+	int32_t reducedY = dims[1] - 2;
+	int32_t * indices = slotIndices[z & 1].data();
+	const int32_t * below = slotIndices[(z + 1) & 1].data();
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi8((char)0xff);
+
+	for (int32_t y = 0; y < reducedY; y++) {
+		classifyRow(y, z, codes.data());
+		int32_t * row = indices + size_t(reducedX) * y;
+		const int32_t * rowBelow = below + size_t(reducedX) * y;
+		for (int32_t block = 0; block < reducedX; block += 16) {
+			// Cells the surface crosses, code neither 0 nor 255
+			__m128i blockCodes = _mm_loadu_si128((const __m128i*)(codes.data() + block));
+			int uniform = _mm_movemask_epi8(_mm_or_si128(
+				_mm_cmpeq_epi8(blockCodes, zero),
+				_mm_cmpeq_epi8(blockCodes, full)
+			));
+			unsigned int crossed = ~uniform & 0xffff;
+			while (crossed) {
+				int32_t x = block + surfaceNetsLowestBit(crossed);
+				crossed &= crossed - 1;
+				int code = codes[x];
+				row[x] = (int32_t)vertices.size();
+				vertices.emplace_back();
+				colors.emplace_back();
+				computeVertex(x, y, z, code, vertices.back(), colors.back());
+				if (!quads) {
+					continue;
+				}
+
+				// Same quads and orientation as dualmc::buildCellQuads
+				int32_t i0, i1, i2, i3;
+				bool inside = (code & 1) != 0;
+				// x edge
+				if (z > 0 && y > 0 && inside != ((code & 2) != 0)) {
+					i0 = row[x];
+					i1 = rowBelow[x];
+					i2 = rowBelow[x - reducedX];
+					i3 = row[x - reducedX];
+					if (!inside) {
+						quadList.emplace_back(i0, i1, i2, i3);
+					}
+					else {
+						quadList.emplace_back(i0, i3, i2, i1);
+					}
+				}
+				// y edge
+				if (z > 0 && x > 0 && inside != ((code & 4) != 0)) {
+					i0 = row[x];
+					i1 = rowBelow[x];
+					i2 = rowBelow[x - 1];
+					i3 = row[x - 1];
+					if (inside) {
+						quadList.emplace_back(i0, i1, i2, i3);
+					}
+					else {
+						quadList.emplace_back(i0, i3, i2, i1);
+					}
+				}
+				// z edge
+				if (x > 0 && y > 0 && inside != ((code & 16) != 0)) {
+					i0 = row[x];
+					i1 = row[x - 1];
+					i2 = row[x - 1 - reducedX];
+					i3 = row[x - reducedX];
+					if (inside) {
+						quadList.emplace_back(i0, i1, i2, i3);
+					}
+					else {
+						quadList.emplace_back(i0, i3, i2, i1);
+					}
+				}
+			}
+		}
+	}
+}
+
+void surfaceNets::computeVertex(
+	const int32_t x,
+	const int32_t y,
+	const int32_t z,
+	const int cubeCode,
+	dualmc::Vertex & vertex,
+	uint8_t & color
+) const {
+	// Mean of the crossings of all edges, the edges of all dual points
+	const uint8_t * voxel = data + (size_t(z) * dims[1] + y) * dims[0] + x;
+	float p[3] = { 0.0f, 0.0f, 0.0f };
+	int count = 0;
+	for (int point = 0; point < 4; point++) {
+		int edgeCount = dualmc::dualPointTables.edgeCount[cubeCode][point];
+		const uint8_t * edges = dualmc::dualPointTables.edges[cubeCode][point];
+		for (int i = 0; i < edgeCount; i++) {
+			int edge = edges[i];
+			float a = (float)voxel[edgeOffsets[edge]];
+			float b = (float)voxel[edgeOffsets[edge] + edgeSteps[edge]];
+			float t = ((float)iso - a) / (b - a);
+			const int32_t * corner = dualmc::edgeStart[edge];
+			int axis = dualmc::edgeAxis[edge];
+			p[0] += (float)corner[0] + (axis == 0 ? t : 0.0f);
+			p[1] += (float)corner[1] + (axis == 1 ? t : 0.0f);
+			p[2] += (float)corner[2] + (axis == 2 ? t : 0.0f);
+		}
+		count += edgeCount;
+	}
+	float invPoints = 1.0f / (float)count;
+	vertex.x = (float)x + p[0] * invPoints;
+	vertex.y = (float)y + p[1] * invPoints;
+	vertex.z = (float)z + p[2] * invPoints;
+	color = voxel[0];
+}
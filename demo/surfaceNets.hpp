@@ -0,0 +1,91 @@
+#ifndef SURFACENETS_HPP
+#define SURFACENETS_HPP
+
+// Naive surface nets: one vertex per cell the surface crosses, at the
+// mean of the crossings of its edges, and a quad per crossing grid edge.
+// The quads are those of dualmc, in the same order and orientation;
+// where dualmc gives a cell several dual points they are one vertex here.
+// Slice by slice, the vertex indices of the cells live in a rolling
+// buffer of two cell slices, the current one and the one below, which is
+// all the quads of an edge slice need. Cells are classified 16 at a time
+// with SSE2 and only the crossed ones are visited.
+// Every crossed cell gets a vertex, also along the volume border where
+// no quad may use it.
+class surfaceNets {
+public:
+	// Same as dualmc::build
+	void build(
+		const uint8_t * data,
+		const int32_t dimX,
+		const int32_t dimY,
+		const int32_t dimZ,
+		const uint8_t iso,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors
+	);
+
+	// Same as dualmc::buildSlab
+	void buildSlab(
+		const uint8_t * data,
+		const int32_t dimX,
+		const int32_t dimY,
+		const int32_t dimZ,
+		const uint8_t iso,
+		const int32_t zBegin,
+		const int32_t zEnd,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors,
+		std::vector<size_t> & sliceQuads
+	);
+
+private:
+	void extract(
+		const int32_t zBegin,
+		const int32_t zEnd,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quads,
+		std::vector<uint8_t> & colors,
+		std::vector<size_t> * sliceQuads
+	);
+
+	// Cube codes of the cells of row (y,z), codes is padded to 16 cells
+	// with zeros
+	void classifyRow(const int32_t y, const int32_t z, uint8_t * codes) const;
+
+	// Vertices of the crossed cells of cell slice z, and with quads the
+	// quads of the grid edges starting in the slice
+	void extractSlice(
+		const int32_t z,
+		const bool quads,
+		std::vector<dualmc::Vertex> & vertices,
+		std::vector<dualmc::Quad> & quadList,
+		std::vector<uint8_t> & colors
+	);
+
+	// Vertex of cell (x,y,z)
+	void computeVertex(
+		const int32_t x,
+		const int32_t y,
+		const int32_t z,
+		const int cubeCode,
+		dualmc::Vertex & vertex,
+		uint8_t & color
+	) const;
+
+	const uint8_t * data = nullptr;
+	int32_t dims[3] = { 0, 0, 0 };
+	uint8_t iso = 0;
+
+	// Offset of the start voxel of every cube edge from the cell, and
+	// to its end voxel
+	size_t edgeOffsets[12];
+	size_t edgeSteps[12];
+
+	// Vertex index of the cells of slice z in slot z % 2, x fastest
+	std::vector<int32_t> slotIndices[2];
+	std::vector<uint8_t> codes;
+};
+
+#endif // SURFACENETS_HPP
@@ -0,0 +1,282 @@
+// Include standard liabraries
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+#include "taskScheduler.hpp"
+
+struct taskNode {
+	std::function<void()> function;
+	taskGroup * group;
+	// Unfinished dependencies, plus one until the task is started
+	std::atomic<int> unfinished{ 1 };
+
+	std::mutex mutex;
+	bool finished = false;
+	// Tasks waiting for this one
+	std::vector<taskHandle> successors;
+};
+
+// Worker of the current thread, if it is one
+static thread_local taskScheduler * currentScheduler = nullptr;
+static thread_local unsigned int currentWorker = 0;
+
+static std::atomic<unsigned int> globalConcurrency(0);
+
+taskScheduler::~taskScheduler() {
+	release();
+}
+
+void taskScheduler::init(unsigned int threadCount) {
+	release();
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	stopping = false;
+	for (unsigned int thread = 0; thread < threadCount; thread++) {
+		queues.emplace_back(new Worker());
+	}
+	for (unsigned int thread = 0; thread < threadCount; thread++) {
+		workers.emplace_back(&taskScheduler::workerLoop, this, thread);
+	}
+}
+
+void taskScheduler::release() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+	for (auto & worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+	queues.clear();
+}
+
+taskHandle taskScheduler::run(
+	taskGroup & group,
+	std::function<void()> task,
+	const std::vector<taskHandle> & dependencies
+) {
+	taskHandle node = std::make_shared<taskNode>();
+	node->function = std::move(task);
+	node->group = &group;
+	group.pending++;
+
+	for (auto const & dependency : dependencies) {
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (!dependency->finished) {
+			node->unfinished++;
+			dependency->successors.push_back(node);
+		}
+	}
+	// Started; queued now unless a dependency is still running
+	if (--node->unfinished == 0) {
+		push(node);
+	}
+	return node;
+}
+
+void taskScheduler::wait(taskGroup & group) {
+	while (!group.isDone()) {
+		taskHandle task = take();
+		if (task) {
+			execute(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&]() {
+			return group.isDone() || queued.load() > 0;
+		});
+	}
+}
+
+void taskScheduler::parallelFor(
+	const Range3D & range,
+	const int grain[3],
+	const std::function<void(const Range3D &)> & body
+) {
+	for (int axis = 0; axis < 3; axis++) {
+		if (range.end[axis] <= range.begin[axis]) {
+			return;
+		}
+	}
+	taskGroup group;
+	split(group, range, grain, body);
+	wait(group);
+}
+
+void taskScheduler::parallelFor(
+	const int begin,
+	const int end,
+	const int grain,
+	const std::function<void(int, int)> & body
+) {
+	Range3D range = { { begin, 0, 0 }, { end, 1, 1 } };
+	int grains[3] = { std::max(grain, 1), 1, 1 };
+	parallelFor(range, grains, [&](const Range3D & piece) {
+		body(piece.begin[0], piece.end[0]);
+	});
+}
+
+taskScheduler & taskScheduler::global() {
+	static taskScheduler scheduler;
+	static std::once_flag started;
+	std::call_once(started, [&]() {
+		scheduler.init(globalConcurrency.load());
+	});
+	return scheduler;
+}
+
+void taskScheduler::setConcurrency(const unsigned int threadCount) {
+	globalConcurrency = threadCount;
+}
+
+void taskScheduler::workerLoop(const unsigned int index) {
+	currentScheduler = this;
+	currentWorker = index;
+	while (true) {
+		taskHandle task = take();
+		if (task) {
+			execute(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		// Started tasks are finished before stopping
+		if (stopping && queued.load() == 0) {
+			break;
+		}
+		changed.wait(lock, [&]() {
+			return stopping || queued.load() > 0;
+		});
+	}
+	currentScheduler = nullptr;
+}
+
+void taskScheduler::push(const taskHandle & task) {
+	if (currentScheduler == this) {
+		Worker & own = *queues[currentWorker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		own.tasks.push_back(task);
+		queued++;
+	}
+	else {
+		std::lock_guard<std::mutex> lock(mutex);
+		shared.push_back(task);
+		queued++;
+	}
+	// Sleeping threads check queued under the mutex
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+	}
+	changed.notify_one();
+}
+
+taskHandle taskScheduler::take() {
+	if (queued.load() == 0) {
+		return taskHandle();
+	}
+	taskHandle task;
+
+	unsigned int first = 0;
+	if (currentScheduler == this) {
+		Worker & own = *queues[currentWorker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			queued--;
+			return task;
+		}
+		first = currentWorker + 1;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!shared.empty()) {
+			task = std::move(shared.front());
+			shared.pop_front();
+			queued--;
+			return task;
+		}
+	}
+
+	// Steal the oldest task of another worker
+	for (size_t i = 0; i < queues.size(); i++) {
+		Worker & victim = *queues[(first + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			queued--;
+			return task;
+		}
+	}
+	return taskHandle();
+}
+
+void taskScheduler::execute(const taskHandle & task) {
+	task->function();
+	// Release what the task captured
+	task->function = nullptr;
+
+	std::vector<taskHandle> successors;
+	{
+		std::lock_guard<std::mutex> lock(task->mutex);
+		task->finished = true;
+		successors.swap(task->successors);
+	}
+	for (auto const & successor : successors) {
+		if (--successor->unfinished == 0) {
+			push(successor);
+		}
+	}
+
+	if (--task->group->pending == 0) {
+		// Wake up the threads waiting for the group
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+		}
+		changed.notify_all();
+	}
+}
+
+void taskScheduler::split(
+	taskGroup & group,
+	Range3D range,
+	const int grain[3],
+	const std::function<void(const Range3D &)> & body
+) {
+	while (true) {
+		// Axis with the most grains left
+		int axis = -1;
+		int mostGrains = 1;
+		for (int i = 0; i < 3; i++) {
+			int grains = (range.end[i] - range.begin[i] + grain[i] - 1) / grain[i];
+			if (grains > mostGrains) {
+				mostGrains = grains;
+				axis = i;
+			}
+		}
+		if (axis < 0) {
+			body(range);
+			return;
+		}
+
+		// Upper half as a task, go on with the lower half
+		int middle = range.begin[axis] + (mostGrains / 2) * grain[axis];
+		Range3D upper = range;
+		upper.begin[axis] = middle;
+		range.end[axis] = middle;
+		run(group, [this, &group, upper, grain, &body]() {
+			split(group, upper, grain, body);
+		});
+	}
+}
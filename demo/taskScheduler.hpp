@@ -0,0 +1,119 @@
+#ifndef TASKSCHEDULER_HPP
+#define TASKSCHEDULER_HPP
+
+// Tasks started together, to wait for them as a whole
+class taskGroup {
+public:
+	bool isDone() const { return pending.load() == 0; }
+
+private:
+	friend class taskScheduler;
+	std::atomic<int> pending{ 0 };
+};
+
+// A started task, to make other tasks depend on it
+struct taskNode;
+typedef std::shared_ptr<taskNode> taskHandle;
+
+// Box of integer coordinates [begin, end) along x, y and z
+struct Range3D {
+	int begin[3];
+	int end[3];
+};
+
+// Work-stealing scheduler shared by everything that runs in parallel
+// (loading stages, filters, meshing, normals, CPU renderers, image
+// writing), so they share one set of threads instead of each starting
+// its own.
+// Every worker owns a deque: tasks started on a worker go to the back
+// of its deque and it takes its newest task first, while idle workers
+// steal the oldest task from the front of another's deque. Tasks
+// started on other threads go to a shared queue. A thread waiting for
+// a group runs tasks meanwhile, so tasks can wait for other tasks.
+class taskScheduler {
+public:
+	~taskScheduler();
+
+	// threadCount 0 uses all hardware threads
+	void init(unsigned int threadCount);
+
+	// Stop the workers once the started tasks are done
+	void release();
+
+	unsigned int getThreadCount() const { return (unsigned int)workers.size(); }
+
+	// Run task counted in group, once every task in dependencies has
+	// finished (right away without dependencies)
+	taskHandle run(
+		taskGroup & group,
+		std::function<void()> task,
+		const std::vector<taskHandle> & dependencies = std::vector<taskHandle>()
+	);
+
+	// Run tasks on this thread too until every task of group has finished
+	void wait(taskGroup & group);
+
+	// Call body on pieces of range in parallel and wait for all of them.
+	// Pieces are split along the axis with the most grains until they
+	// are at most grain[axis] long along every axis.
+	void parallelFor(
+		const Range3D & range,
+		const int grain[3],
+		const std::function<void(const Range3D &)> & body
+	);
+
+	// One dimensional parallelFor, body(begin, end)
+	void parallelFor(
+		const int begin,
+		const int end,
+		const int grain,
+		const std::function<void(int, int)> & body
+	);
+
+	// The scheduler of the application, started on first use with the
+	// thread count of setConcurrency
+	static taskScheduler & global();
+
+	// Thread count of the global scheduler (0: all hardware threads).
+	// Has to be set before its first use.
+	static void setConcurrency(const unsigned int threadCount);
+
+private:
+	struct Worker {
+		std::deque<taskHandle> tasks;
+		std::mutex mutex;
+	};
+
+	void workerLoop(const unsigned int index);
+
+	// Queue a task whose dependencies have finished
+	void push(const taskHandle & task);
+
+	// Take a task: own newest, shared oldest, then steal
+	taskHandle take();
+
+	// Run a taken task and start the tasks depending on it
+	void execute(const taskHandle & task);
+
+	// Split range into tasks of group
+	void split(
+		taskGroup & group,
+		Range3D range,
+		const int grain[3],
+		const std::function<void(const Range3D &)> & body
+	);
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<Worker>> queues;
+	std::deque<taskHandle> shared;
+	// Tasks in all queues
+	std::atomic<int> queued{ 0 };
+
+	// Guards shared, sleeping and waking up
+	std::mutex mutex;
+	// New tasks, finished groups or stopping
+	std::condition_variable changed;
+	bool stopping = false;
+};
+
+#endif // TASKSCHEDULER_HPP
@@ -85,6 +85,36 @@ GLuint loadBMP(const char * imagepath) {
 	return textureID;
 }
 
+bool saveBMP(const char * imagepath, const unsigned int width, const unsigned int height, const unsigned char * data) {
+
+	// Rows are padded to 4 bytes, like glReadPixels with the default GL_PACK_ALIGNMENT
+	unsigned int rowSize = (width * 3 + 3) & ~3u;
+	unsigned int imageSize = rowSize * height;
+
+	// 54 bytes of file and info header, 24bpp, no compression
+	unsigned char header[54] = { 0 };
+	header[0] = 'B';
+	header[1] = 'M';
+	*(unsigned int*)&(header[0x02]) = 54 + imageSize;
+	*(unsigned int*)&(header[0x0A]) = 54;
+	*(unsigned int*)&(header[0x0E]) = 40;
+	*(int*)&(header[0x12]) = width;
+	*(int*)&(header[0x16]) = height;
+	*(unsigned short*)&(header[0x1A]) = 1;
+	*(unsigned short*)&(header[0x1C]) = 24;
+	*(unsigned int*)&(header[0x22]) = imageSize;
+
+	FILE * file = fopen(imagepath, "wb");
+	if (!file) {
+		printf("%s could not be opened for writing\n", imagepath);
+		return false;
+	}
+	bool written = fwrite(header, 1, 54, file) == 54
+		&& fwrite(data, 1, imageSize, file) == imageSize;
+	fclose(file);
+	return written;
+}
+
 // DDS part
 #define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
 #define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
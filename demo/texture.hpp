@@ -4,6 +4,9 @@
 // Load a .BMP file using our custom loader
 GLuint loadBMP(const char * imagepath);
 
+// Save bottom-up BGR rows (padded to 4 bytes) as a 24bpp .BMP file
+bool saveBMP(const char * imagepath, const unsigned int width, const unsigned int height, const unsigned char * data);
+
 // Load a .DDS file using GLFW's own loader
 GLuint loadDDS(const char * imagepath);
 
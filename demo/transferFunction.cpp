@@ -0,0 +1,102 @@
+﻿// Include standard liabraries
+#include <vector>
+#include <cstdint>
+#include <climits>
+
+// GLEW
+#include <GL/glew.h>
+
+#include "transferFunction.hpp"
+
+/*
+CN:
+CT 值：
+骨组织:		>400	肝脏:	50-70	脾脏:	35-60
+血块:		64-84	胰腺:	30-55	肾脏:	25-50
+肌肉:		40-55	胆囊:	10-30	血液:	13-32
+水:			0			血浆:	3-14		脂肪:	-100-[-20]
+脑白质:		25-34	脑灰质:	28-44	脑脊液:	3-8
+甲状腺:		50-90
+
+传递函数只区分:
+1. 脂肪			-100-[-20]	RGB: (255,165,40)
+2. 水				0				RGB: (127,255,212)
+3. 血浆			3-10			RGB: (135,35,10)
+4. 胆囊			11-30		RGB: (0,139,0)
+5. 混合部分	31-50		RGB: (235,20,90)
+6. 肝脏			51-70		RGB: (0,205,0)
+7. 骨				>400		RGB: (190,190,190)
+肾脏，胰腺，肌肉，脾脏统合为一种颜色(5)，因为目前难以区分
+其他CT值为白色 (255,255,255)
+
+脑部几个加甲状腺没处理，
+可能需要dcmtk获取tag：Body Part Examined (0018,0015) --> HEAD
+*/
+
+// Colors as in the old Texture.bmp.
+// Like the old UV lookup, bone starts right above the liver range.
+const TissueClass TISSUE_CLASSES[] = {
+	{ INT_MIN, -1, 255, 165, 40 },	// Fat
+	{ 0, 0, 127, 255, 212 },		// Water
+	{ 1, 10, 135, 35, 10 },			// Plasma
+	{ 11, 30, 0, 139, 0 },			// Gallbladder
+	{ 31, 50, 235, 20, 90 },		// Mixed (kidney, pancreas, muscle, spleen)
+	{ 51, 70, 0, 205, 0 },			// Liver
+	{ 71, INT_MAX, 188, 143, 39 }	// Bone
+};
+const int TISSUE_CLASS_COUNT = sizeof(TISSUE_CLASSES) / sizeof(TISSUE_CLASSES[0]);
+
+void buildTransferFunction(
+	const TissueClass * classes,
+	const int classCount,
+	const int & rescale_intercept,
+	const unsigned short & rescale_slope,
+	const uint8_t threshold,
+	std::vector<unsigned char> & rgb
+) {
+	rgb.assign(3 * TRANSFER_FUNCTION_SIZE, 255);
+	for (int value = 0; value < TRANSFER_FUNCTION_SIZE; value++) {
+		// Hu = pixel * slope + intercept
+		int ct = (value < threshold ? threshold : value) * rescale_slope
+			+ ((float)rescale_intercept / 4096.0f * 255.0f);
+		for (int i = 0; i < classCount; i++) {
+			if (ct >= classes[i].minCT && ct <= classes[i].maxCT) {
+				rgb[3 * value] = classes[i].r;
+				rgb[3 * value + 1] = classes[i].g;
+				rgb[3 * value + 2] = classes[i].b;
+				break;
+			}
+		}
+	}
+}
+
+void buildOpacityFunction(
+	const uint8_t low,
+	const uint8_t high,
+	const float maxOpacity,
+	std::vector<float> & opacity
+) {
+	opacity.assign(TRANSFER_FUNCTION_SIZE, 0.0f);
+	for (int value = low + 1; value < TRANSFER_FUNCTION_SIZE; value++) {
+		float ramp = value >= high ? 1.0f : float(value - low) / float(high - low);
+		opacity[value] = maxOpacity * ramp;
+	}
+}
+
+GLuint createTransferFunctionTexture(const std::vector<unsigned char> & rgb) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_1D, texture);
+
+	// Classes are discrete, so no filtering between entries
+	glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB8, TRANSFER_FUNCTION_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+void updateTransferFunctionTexture(const GLuint texture, const std::vector<unsigned char> & rgb) {
+	glBindTexture(GL_TEXTURE_1D, texture);
+	glTexSubImage1D(GL_TEXTURE_1D, 0, 0, TRANSFER_FUNCTION_SIZE, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+}
@@ -0,0 +1,48 @@
+#ifndef TRANSFERFUNCTION_HPP
+#define TRANSFERFUNCTION_HPP
+
+// A tissue class: inclusive range of CT numbers and its color
+struct TissueClass {
+	int minCT;
+	int maxCT;
+	unsigned char r;
+	unsigned char g;
+	unsigned char b;
+};
+
+// Classification table, see transferFunction.cpp
+extern const TissueClass TISSUE_CLASSES[];
+extern const int TISSUE_CLASS_COUNT;
+
+// Entries of the transfer function, one per raw voxel value
+const int TRANSFER_FUNCTION_SIZE = 256;
+
+// Color of every raw voxel value (RGB, TRANSFER_FUNCTION_SIZE entries).
+// CT number = value * slope + intercept / 4096 * 255, values below
+// threshold take the color of threshold. The first matching class
+// wins, CT numbers outside every class are white.
+void buildTransferFunction(
+	const TissueClass * classes,
+	const int classCount,
+	const int & rescale_intercept,
+	const unsigned short & rescale_slope,
+	const uint8_t threshold,
+	std::vector<unsigned char> & rgb
+);
+
+// Opacity of every raw voxel value for volume rendering, per voxel of
+// ray length: 0 up to low, rising linearly to maxOpacity at high
+void buildOpacityFunction(
+	const uint8_t low,
+	const uint8_t high,
+	const float maxOpacity,
+	std::vector<float> & opacity
+);
+
+// 1D texture sampled with the raw value of each vertex
+GLuint createTransferFunctionTexture(const std::vector<unsigned char> & rgb);
+
+// Change the color mapping; no vertex data is touched
+void updateTransferFunctionTexture(const GLuint texture, const std::vector<unsigned char> & rgb);
+
+#endif // TRANSFERFUNCTION_HPP
@@ -0,0 +1,52 @@
+#ifndef TRILINEAR_HPP
+#define TRILINEAR_HPP
+
+// Trilinear samples of an 8-bit volume (x fastest) at 4 positions.
+// Positions have to stay below dim - 1 on every axis (e.g. clamped to
+// dim - 1.001) so the upper neighbours exist. Weights and interpolation
+// use SSE, the 8 voxels are fetched per lane (SSE2 has no gather).
+// Needs <emmintrin.h>.
+inline __m128 sampleTrilinear4(
+	const uint8_t * data,
+	const int dims[3],
+	const __m128 X,
+	const __m128 Y,
+	const __m128 Z
+) {
+	size_t sliceSize = size_t(dims[0]) * dims[1];
+	__m128i IX = _mm_cvttps_epi32(X);
+	__m128i IY = _mm_cvttps_epi32(Y);
+	__m128i IZ = _mm_cvttps_epi32(Z);
+	__m128 fx = _mm_sub_ps(X, _mm_cvtepi32_ps(IX));
+	__m128 fy = _mm_sub_ps(Y, _mm_cvtepi32_ps(IY));
+	__m128 fz = _mm_sub_ps(Z, _mm_cvtepi32_ps(IZ));
+	alignas(16) int ix[4], iy[4], iz[4];
+	_mm_store_si128((__m128i *)ix, IX);
+	_mm_store_si128((__m128i *)iy, IY);
+	_mm_store_si128((__m128i *)iz, IZ);
+
+	alignas(16) float c[8][4];
+	for (int lane = 0; lane < 4; lane++) {
+		const uint8_t * v = data + ix[lane] + dims[0] * size_t(iy[lane]) + sliceSize * iz[lane];
+		c[0][lane] = v[0];
+		c[1][lane] = v[1];
+		c[2][lane] = v[dims[0]];
+		c[3][lane] = v[dims[0] + 1];
+		c[4][lane] = v[sliceSize];
+		c[5][lane] = v[sliceSize + 1];
+		c[6][lane] = v[sliceSize + dims[0]];
+		c[7][lane] = v[sliceSize + dims[0] + 1];
+	}
+
+	__m128 lerp[4];
+	for (int i = 0; i < 4; i++) {
+		__m128 c0 = _mm_load_ps(c[2 * i]);
+		__m128 c1 = _mm_load_ps(c[2 * i + 1]);
+		lerp[i] = _mm_add_ps(c0, _mm_mul_ps(fx, _mm_sub_ps(c1, c0)));
+	}
+	__m128 s0 = _mm_add_ps(lerp[0], _mm_mul_ps(fy, _mm_sub_ps(lerp[1], lerp[0])));
+	__m128 s1 = _mm_add_ps(lerp[2], _mm_mul_ps(fy, _mm_sub_ps(lerp[3], lerp[2])));
+	return _mm_add_ps(s0, _mm_mul_ps(fz, _mm_sub_ps(s1, s0)));
+}
+
+#endif // TRILINEAR_HPP
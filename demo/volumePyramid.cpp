@@ -0,0 +1,124 @@
+// Include standard liabraries
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+// SSE2, always available on x64
+#include <emmintrin.h>
+
+#include "taskScheduler.hpp"
+#include "volumePyramid.hpp"
+
+// One output row from the four input rows of its 2x2 block
+static void downsampleRow(
+	const uint8_t * row00,
+	const uint8_t * row10,
+	const uint8_t * row01,
+	const uint8_t * row11,
+	uint8_t * out,
+	const unsigned int width
+) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i rounding = _mm_set1_epi16(4);
+
+	unsigned int x = 0;
+	// 16 input voxels to 8 output voxels per step
+	for (; x + 8 <= width; x += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(row00 + 2 * x));
+		__m128i b = _mm_loadu_si128((const __m128i*)(row10 + 2 * x));
+		__m128i c = _mm_loadu_si128((const __m128i*)(row01 + 2 * x));
+		__m128i d = _mm_loadu_si128((const __m128i*)(row11 + 2 * x));
+
+		// Sum the four rows in 16 bits
+		__m128i low = _mm_add_epi16(
+			_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+			_mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero)));
+		__m128i high = _mm_add_epi16(
+			_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+			_mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero)));
+
+		// Add neighbouring columns, then round and divide by 8
+		__m128i sums = _mm_packs_epi32(_mm_madd_epi16(low, ones), _mm_madd_epi16(high, ones));
+		sums = _mm_srli_epi16(_mm_add_epi16(sums, rounding), 3);
+		_mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(sums, sums));
+	}
+	for (; x < width; x++) {
+		unsigned int sum = row00[2 * x] + row00[2 * x + 1]
+			+ row10[2 * x] + row10[2 * x + 1]
+			+ row01[2 * x] + row01[2 * x + 1]
+			+ row11[2 * x] + row11[2 * x + 1];
+		out[x] = (uint8_t)((sum + 4) / 8);
+	}
+}
+
+void downsampleVolume(
+	const std::vector<uint8_t> & src,
+	const unsigned int srcDims[3],
+	std::vector<uint8_t> & dst,
+	unsigned int dstDims[3]
+) {
+	for (int axis = 0; axis < 3; axis++) {
+		dstDims[axis] = srcDims[axis] / 2;
+	}
+	dst.resize(size_t(dstDims[0]) * dstDims[1] * dstDims[2]);
+	if (dst.empty()) {
+		return;
+	}
+	size_t srcRow = srcDims[0];
+	size_t srcSlice = srcRow * srcDims[1];
+	size_t dstRow = dstDims[0];
+	size_t dstSlice = dstRow * dstDims[1];
+
+	// One output slice per task
+	taskScheduler::global().parallelFor(0, (int)dstDims[2], 1, [&](int zBegin, int zEnd) {
+		for (unsigned int z = zBegin; z < (unsigned int)zEnd; z++) {
+			const uint8_t * slice0 = &src[2 * z * srcSlice];
+			const uint8_t * slice1 = slice0 + srcSlice;
+			for (unsigned int y = 0; y < dstDims[1]; y++) {
+				downsampleRow(
+					slice0 + 2 * y * srcRow,
+					slice0 + (2 * y + 1) * srcRow,
+					slice1 + 2 * y * srcRow,
+					slice1 + (2 * y + 1) * srcRow,
+					&dst[z * dstSlice + y * dstRow],
+					dstDims[0]
+				);
+			}
+		}
+	});
+}
+
+void buildVolumePyramid(
+	const std::vector<uint8_t> & raw,
+	const unsigned int dimX,
+	const unsigned int dimY,
+	const unsigned int dimZ,
+	const unsigned int levelCount,
+	std::vector<VolumeLevel> & levels
+) {
+	levels.clear();
+	// Every level is filtered from the previous one, which must not move
+	levels.reserve(levelCount);
+	const std::vector<uint8_t> * src = &raw;
+	unsigned int srcDims[3] = { dimX, dimY, dimZ };
+	for (unsigned int level = 1; level <= levelCount; level++) {
+		if (std::min(srcDims[0], std::min(srcDims[1], srcDims[2])) / 2 < 3) {
+			break;
+		}
+		levels.emplace_back();
+		VolumeLevel & next = levels.back();
+		next.level = level;
+		downsampleVolume(*src, srcDims, next.data, next.dims);
+
+		src = &next.data;
+		std::copy(next.dims, next.dims + 3, srcDims);
+	}
+}
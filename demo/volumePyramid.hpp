@@ -0,0 +1,36 @@
+#ifndef VOLUMEPYRAMID_HPP
+#define VOLUMEPYRAMID_HPP
+
+// Volume downsampled by 2^level along every axis, x fastest.
+// Voxel i of a level is centered on voxel 2^level * i + (2^level - 1) / 2
+// of the full volume.
+struct VolumeLevel {
+	unsigned int level;
+	unsigned int dims[3];
+	std::vector<uint8_t> data;
+};
+
+// Average every 2x2x2 block of src into one voxel (box filter, rounded).
+// An odd last row, column or slice is dropped. Rows are filtered 16
+// voxels at a time with SSE, slices are filtered in parallel on the
+// global taskScheduler.
+void downsampleVolume(
+	const std::vector<uint8_t> & src,
+	const unsigned int srcDims[3],
+	std::vector<uint8_t> & dst,
+	unsigned int dstDims[3]
+);
+
+// Levels 1 to levelCount (2x, 4x, 8x, ...) of raw, each filtered from
+// the previous one. Stops early once a level would be thinner than
+// 3 voxels, the minimum dualmc can mesh.
+void buildVolumePyramid(
+	const std::vector<uint8_t> & raw,
+	const unsigned int dimX,
+	const unsigned int dimY,
+	const unsigned int dimZ,
+	const unsigned int levelCount,
+	std::vector<VolumeLevel> & levels
+);
+
+#endif // VOLUMEPYRAMID_HPP
@@ -0,0 +1,426 @@
+// Include standard liabraries
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+// SSE2, always available on x64
+#include <emmintrin.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "taskScheduler.hpp"
+#include "trilinear.hpp"
+#include "softwareRasterizer.hpp"
+#include "volumeRenderer.hpp"
+
+const float volumeRenderer::SAMPLE_STEP = 0.5f;
+
+// Rays whose opacity reaches this are finished
+static const float OPAQUE_ALPHA = 0.99f;
+
+// Lane mask of a movemask result
+static __m128 laneMask(const int bits) {
+	return _mm_castsi128_ps(_mm_setr_epi32(
+		bits & 1 ? -1 : 0,
+		bits & 2 ? -1 : 0,
+		bits & 4 ? -1 : 0,
+		bits & 8 ? -1 : 0));
+}
+
+void volumeRenderer::init(const int width, const int height) {
+	this->width = width;
+	this->height = height;
+}
+
+void volumeRenderer::setVolume(
+	const std::vector<uint8_t> & raw,
+	const unsigned int dimX,
+	const unsigned int dimY,
+	const unsigned int dimZ
+) {
+	this->raw = &raw;
+	dims[0] = dimX;
+	dims[1] = dimY;
+	dims[2] = dimZ;
+	for (int a = 0; a < 3; a++) {
+		bricks[a] = (dims[a] + BRICK_SIZE - 1) / BRICK_SIZE;
+	}
+
+	// Brick b holds the cells starting at voxels [b * BRICK_SIZE, (b + 1) * BRICK_SIZE),
+	// their samples also read the next voxel
+	brickRanges.assign(size_t(bricks[0]) * bricks[1] * bricks[2], Brick{ 255, 0 });
+	size_t sliceSize = size_t(dimX) * dimY;
+	for (unsigned int z = 0; z < dimZ; z++) {
+		int bz0 = std::min(int(z / BRICK_SIZE), bricks[2] - 1);
+		int bz1 = z % BRICK_SIZE == 0 && z > 0 ? bz0 - 1 : bz0;
+		for (unsigned int y = 0; y < dimY; y++) {
+			int by0 = std::min(int(y / BRICK_SIZE), bricks[1] - 1);
+			int by1 = y % BRICK_SIZE == 0 && y > 0 ? by0 - 1 : by0;
+			const uint8_t * row = &raw[z * sliceSize + size_t(y) * dimX];
+			for (unsigned int x = 0; x < dimX; x++) {
+				int bx0 = std::min(int(x / BRICK_SIZE), bricks[0] - 1);
+				int bx1 = x % BRICK_SIZE == 0 && x > 0 ? bx0 - 1 : bx0;
+				uint8_t value = row[x];
+				// A voxel on a brick border also belongs to the previous brick
+				for (int bz = bz1; bz <= bz0; bz++) {
+					for (int by = by1; by <= by0; by++) {
+						for (int bx = bx1; bx <= bx0; bx++) {
+							Brick & brick = brickRanges[bx + bricks[0] * (by + size_t(bricks[1]) * bz)];
+							brick.minValue = std::min(brick.minValue, value);
+							brick.maxValue = std::max(brick.maxValue, value);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void volumeRenderer::setTransferFunction(const std::vector<unsigned char> & rgb, const std::vector<float> & opacity) {
+	transfer.resize(rgb.size() / 3);
+	for (size_t i = 0; i < transfer.size(); i++) {
+		transfer[i] = glm::vec3(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]) / 255.0f;
+	}
+	this->opacity = opacity;
+}
+
+void volumeRenderer::setIso(const uint8_t iso) {
+	this->iso = iso;
+}
+
+void volumeRenderer::setLights(const std::vector<glm::vec3> & positions, const std::vector<float> & powers) {
+	lightPositions = positions;
+	lightPowers = powers;
+}
+
+void volumeRenderer::render(
+	const VolumeMode mode,
+	const glm::mat4 & ProjectionMatrix,
+	const glm::mat4 & ViewMatrix,
+	const glm::mat4 & ModelMatrix,
+	std::vector<unsigned char> & image
+) {
+	this->mode = mode;
+	MV = ViewMatrix * ModelMatrix;
+	InverseMVP = glm::inverse(ProjectionMatrix * MV);
+	NormalMatrix = glm::transpose(glm::inverse(glm::mat3(MV)));
+
+	lightsCamera.resize(lightPositions.size());
+	for (size_t i = 0; i < lightPositions.size(); i++) {
+		lightsCamera[i] = glm::vec3(ViewMatrix * glm::vec4(lightPositions[i], 1.0f));
+	}
+
+	// Opacity correction for the sample distance, colors premultiplied
+	size_t valueCount = std::min(transfer.size(), opacity.size());
+	stepAlpha.assign(256, 0.0f);
+	stepColor.assign(256, glm::vec3(0.0f));
+	for (size_t v = 0; v < valueCount; v++) {
+		stepAlpha[v] = 1.0f - std::pow(1.0f - std::min(opacity[v], OPAQUE_ALPHA), SAMPLE_STEP);
+		stepColor[v] = transfer[v] * stepAlpha[v];
+	}
+
+	// Bricks without any visible value (DVR) or entirely below iso (ISO)
+	std::vector<int> visibleBelow(257, 0);
+	for (int v = 0; v < 256; v++) {
+		visibleBelow[v + 1] = visibleBelow[v] + (stepAlpha[v] > 0.0f ? 1 : 0);
+	}
+	brickEmpty.resize(brickRanges.size());
+	for (size_t b = 0; b < brickRanges.size(); b++) {
+		const Brick & brick = brickRanges[b];
+		if (mode == VOLUME_DVR) {
+			brickEmpty[b] = visibleBelow[brick.maxValue + 1] == visibleBelow[brick.minValue];
+		}
+		else {
+			brickEmpty[b] = brick.maxValue < iso;
+		}
+	}
+
+	// Rows padded to 4 bytes
+	image.resize(size_t((width * 3 + 3) & ~3) * height);
+
+	int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	int tileCount = tilesX * ((height + TILE_SIZE - 1) / TILE_SIZE);
+	taskScheduler::global().parallelFor(0, tileCount, 1, [&](int begin, int end) {
+		for (int tile = begin; tile < end; tile++) {
+			renderTile((tile % tilesX) * TILE_SIZE, (tile / tilesX) * TILE_SIZE, image);
+		}
+	});
+}
+
+float volumeRenderer::sample(const glm::vec3 & p) const {
+	// Keep the upper neighbour inside the volume
+	float x = glm::clamp(p.x, 0.0f, dims[0] - 1.001f);
+	float y = glm::clamp(p.y, 0.0f, dims[1] - 1.001f);
+	float z = glm::clamp(p.z, 0.0f, dims[2] - 1.001f);
+	int ix = int(x);
+	int iy = int(y);
+	int iz = int(z);
+	float fx = x - ix;
+	float fy = y - iy;
+	float fz = z - iz;
+	size_t sliceSize = size_t(dims[0]) * dims[1];
+	const uint8_t * v = &(*raw)[ix + dims[0] * size_t(iy) + sliceSize * iz];
+	float c00 = v[0] + fx * (v[1] - v[0]);
+	float c10 = v[dims[0]] + fx * (v[dims[0] + 1] - v[dims[0]]);
+	float c01 = v[sliceSize] + fx * (v[sliceSize + 1] - v[sliceSize]);
+	float c11 = v[sliceSize + dims[0]] + fx * (v[sliceSize + dims[0] + 1] - v[sliceSize + dims[0]]);
+	float c0 = c00 + fy * (c10 - c00);
+	float c1 = c01 + fy * (c11 - c01);
+	return c0 + fz * (c1 - c0);
+}
+
+float volumeRenderer::skipEmptyBricks(
+	const glm::vec3 & origin,
+	const glm::vec3 & direction,
+	float t,
+	const float tEnd,
+	const float mipMax
+) const {
+	while (t < tEnd) {
+		glm::vec3 p = origin + direction * t;
+		int b[3];
+		for (int a = 0; a < 3; a++) {
+			b[a] = glm::clamp(int(p[a]) / BRICK_SIZE, 0, bricks[a] - 1);
+		}
+		size_t index = b[0] + bricks[0] * (b[1] + size_t(bricks[1]) * b[2]);
+		bool empty = mode == VOLUME_MIP
+			? brickRanges[index].maxValue <= mipMax
+			: brickEmpty[index] != 0;
+		if (!empty) {
+			return t;
+		}
+
+		// Continue just behind the nearest face the ray leaves through
+		float exit = tEnd;
+		for (int a = 0; a < 3; a++) {
+			if (direction[a] > 0.0f) {
+				exit = std::min(exit, ((b[a] + 1) * BRICK_SIZE - origin[a]) / direction[a]);
+			}
+			else if (direction[a] < 0.0f) {
+				exit = std::min(exit, (b[a] * BRICK_SIZE - origin[a]) / direction[a]);
+			}
+		}
+		t = std::max(exit, t) + 0.01f;
+	}
+	return t;
+}
+
+void volumeRenderer::renderTile(const int tileX, const int tileY, std::vector<unsigned char> & image) const {
+	size_t rowSize = (width * 3 + 3) & ~3;
+	// Same background as glClearColor in demo.cpp, MIP is shown on black
+	const float background = mode == VOLUME_MIP ? 0.0f : 0.467f;
+	const glm::vec3 boxMax(dims[0] - 1.0f, dims[1] - 1.0f, dims[2] - 1.0f);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 step = _mm_set1_ps(SAMPLE_STEP);
+	const __m128 isoValue = _mm_set1_ps(iso);
+	const __m128 opaque = _mm_set1_ps(OPAQUE_ALPHA);
+	const __m128 hiX = _mm_set1_ps(dims[0] - 1.001f);
+	const __m128 hiY = _mm_set1_ps(dims[1] - 1.001f);
+	const __m128 hiZ = _mm_set1_ps(dims[2] - 1.001f);
+
+	int xEnd = std::min(tileX + TILE_SIZE, width);
+	int yEnd = std::min(tileY + TILE_SIZE, height);
+	for (int y = tileY; y < yEnd; y += 2) {
+		for (int x = tileX; x < xEnd; x += 2) {
+			// 2x2 packet, lane i is pixel (x + i % 2, y + i / 2)
+			alignas(16) float ox[4], oy[4], oz[4], dx[4], dy[4], dz[4];
+			alignas(16) float t[4], tEnd[4];
+			int active = 0;
+			for (int lane = 0; lane < 4; lane++) {
+				int px = x + lane % 2;
+				int py = y + lane / 2;
+				ox[lane] = oy[lane] = oz[lane] = 0.0f;
+				dx[lane] = dy[lane] = dz[lane] = 0.0f;
+				t[lane] = tEnd[lane] = 0.0f;
+				if (px >= width || py >= height) {
+					continue;
+				}
+
+				// Ray through the pixel center in voxel space, t in voxels
+				glm::vec2 ndc((px + 0.5f) / width * 2.0f - 1.0f, (py + 0.5f) / height * 2.0f - 1.0f);
+				glm::vec4 nearPoint = InverseMVP * glm::vec4(ndc, -1.0f, 1.0f);
+				glm::vec4 farPoint = InverseMVP * glm::vec4(ndc, 1.0f, 1.0f);
+				glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+				glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+				float length = glm::length(direction);
+				direction /= length;
+
+				// Clip against the volume box
+				float t0 = 0.0f;
+				float t1 = length;
+				for (int a = 0; a < 3; a++) {
+					if (direction[a] != 0.0f) {
+						float ta = (0.0f - origin[a]) / direction[a];
+						float tb = (boxMax[a] - origin[a]) / direction[a];
+						t0 = std::max(t0, std::min(ta, tb));
+						t1 = std::min(t1, std::max(ta, tb));
+					}
+					else if (origin[a] < 0.0f || origin[a] > boxMax[a]) {
+						t1 = -1.0f;
+					}
+				}
+				ox[lane] = origin.x;
+				oy[lane] = origin.y;
+				oz[lane] = origin.z;
+				dx[lane] = direction.x;
+				dy[lane] = direction.y;
+				dz[lane] = direction.z;
+				t[lane] = t0;
+				tEnd[lane] = t1;
+				if (t0 < t1) {
+					active |= 1 << lane;
+				}
+			}
+			const int hitBox = active;
+
+			const __m128 originX = _mm_load_ps(ox);
+			const __m128 originY = _mm_load_ps(oy);
+			const __m128 originZ = _mm_load_ps(oz);
+			const __m128 directionX = _mm_load_ps(dx);
+			const __m128 directionY = _mm_load_ps(dy);
+			const __m128 directionZ = _mm_load_ps(dz);
+			const __m128 end = _mm_load_ps(tEnd);
+
+			__m128 r = zero, g = zero, b = zero, alpha = zero;
+			__m128 maxValue = zero;
+			alignas(16) float mipMax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			alignas(16) float previous[4] = { -1.0f, -1.0f, -1.0f, -1.0f };
+			float hitT[4] = { -1.0f, -1.0f, -1.0f, -1.0f };
+
+			while (active) {
+				// Empty space skipping, per ray
+				for (int lane = 0; lane < 4; lane++) {
+					if (!(active & (1 << lane))) {
+						continue;
+					}
+					float skipped = skipEmptyBricks(
+						glm::vec3(ox[lane], oy[lane], oz[lane]),
+						glm::vec3(dx[lane], dy[lane], dz[lane]),
+						t[lane], tEnd[lane], mipMax[lane]);
+					if (skipped != t[lane]) {
+						t[lane] = skipped;
+						previous[lane] = -1.0f;
+					}
+					if (t[lane] >= tEnd[lane]) {
+						active &= ~(1 << lane);
+					}
+				}
+				if (!active) {
+					break;
+				}
+				const __m128 mask = laneMask(active);
+
+				// Sample positions, kept inside the volume for idle lanes too
+				__m128 T = _mm_load_ps(t);
+				__m128 X = _mm_min_ps(_mm_max_ps(_mm_add_ps(originX, _mm_mul_ps(directionX, T)), zero), hiX);
+				__m128 Y = _mm_min_ps(_mm_max_ps(_mm_add_ps(originY, _mm_mul_ps(directionY, T)), zero), hiY);
+				__m128 Z = _mm_min_ps(_mm_max_ps(_mm_add_ps(originZ, _mm_mul_ps(directionZ, T)), zero), hiZ);
+
+				__m128 S = sampleTrilinear4(raw->data(), dims, X, Y, Z);
+
+				if (mode == VOLUME_MIP) {
+					maxValue = _mm_or_ps(_mm_and_ps(mask, _mm_max_ps(maxValue, S)), _mm_andnot_ps(mask, maxValue));
+					_mm_store_ps(mipMax, maxValue);
+				}
+				else if (mode == VOLUME_DVR) {
+					// Front-to-back compositing
+					alignas(16) int index[4];
+					alignas(16) float sa[4], sr[4], sg[4], sb[4];
+					_mm_store_si128((__m128i *)index, _mm_cvttps_epi32(_mm_add_ps(S, _mm_set1_ps(0.5f))));
+					for (int lane = 0; lane < 4; lane++) {
+						sa[lane] = stepAlpha[index[lane]];
+						sr[lane] = stepColor[index[lane]].r;
+						sg[lane] = stepColor[index[lane]].g;
+						sb[lane] = stepColor[index[lane]].b;
+					}
+					__m128 transmittance = _mm_and_ps(mask, _mm_sub_ps(one, alpha));
+					r = _mm_add_ps(r, _mm_mul_ps(transmittance, _mm_load_ps(sr)));
+					g = _mm_add_ps(g, _mm_mul_ps(transmittance, _mm_load_ps(sg)));
+					b = _mm_add_ps(b, _mm_mul_ps(transmittance, _mm_load_ps(sb)));
+					alpha = _mm_add_ps(alpha, _mm_mul_ps(transmittance, _mm_load_ps(sa)));
+					// Early ray termination
+					active &= ~_mm_movemask_ps(_mm_cmpge_ps(alpha, opaque));
+				}
+				else {
+					// First sample at or above iso, refined linearly
+					int hits = active & _mm_movemask_ps(_mm_cmpge_ps(S, isoValue));
+					alignas(16) float s[4];
+					_mm_store_ps(s, S);
+					for (int lane = 0; lane < 4; lane++) {
+						if (hits & (1 << lane)) {
+							float back = previous[lane] < 0.0f ? 0.0f
+								: (s[lane] - iso) / (s[lane] - previous[lane]);
+							hitT[lane] = t[lane] - back * SAMPLE_STEP;
+						}
+						previous[lane] = s[lane];
+					}
+					active &= ~hits;
+				}
+
+				T = _mm_add_ps(T, step);
+				_mm_store_ps(t, T);
+				active &= _mm_movemask_ps(_mm_cmplt_ps(T, end));
+			}
+
+			// Write the packet
+			alignas(16) float pr[4], pg[4], pb[4], pa[4];
+			_mm_store_ps(pr, r);
+			_mm_store_ps(pg, g);
+			_mm_store_ps(pb, b);
+			_mm_store_ps(pa, alpha);
+			for (int lane = 0; lane < 4; lane++) {
+				int px = x + lane % 2;
+				int py = y + lane / 2;
+				if (px >= width || py >= height) {
+					continue;
+				}
+				glm::vec3 color(background);
+				if (mode == VOLUME_MIP) {
+					color = glm::vec3(mipMax[lane] / 255.0f);
+				}
+				else if (mode == VOLUME_DVR) {
+					color = glm::vec3(pr[lane], pg[lane], pb[lane]) + (1.0f - pa[lane]) * background;
+				}
+				else if ((hitBox & (1 << lane)) && hitT[lane] >= 0.0f) {
+					glm::vec3 origin(ox[lane], oy[lane], oz[lane]);
+					glm::vec3 direction(dx[lane], dy[lane], dz[lane]);
+					glm::vec3 p = origin + direction * hitT[lane];
+
+					// Values grow into the tissue, the normal points out
+					glm::vec3 gradient(
+						sample(p + glm::vec3(1, 0, 0)) - sample(p - glm::vec3(1, 0, 0)),
+						sample(p + glm::vec3(0, 1, 0)) - sample(p - glm::vec3(0, 1, 0)),
+						sample(p + glm::vec3(0, 0, 1)) - sample(p - glm::vec3(0, 0, 1)));
+					if (glm::dot(gradient, gradient) == 0.0f) {
+						gradient = direction;
+					}
+
+					// Tissue color one voxel below the surface, like the
+					// voxel values dualmc colors the mesh with
+					int value = std::min(255, int(sample(p + direction) + 0.5f));
+					glm::vec3 material = value < (int)transfer.size() ? transfer[value] : glm::vec3(1.0f);
+					color = shadePhong(material, glm::vec3(MV * glm::vec4(p, 1.0f)), NormalMatrix * -gradient,
+						lightsCamera.data(), lightPowers.data(), lightsCamera.size());
+				}
+
+				// BGR like GL_BGR readback
+				color = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+				unsigned char * pixel = &image[py * rowSize + px * 3];
+				pixel[0] = (unsigned char)color.b;
+				pixel[1] = (unsigned char)color.g;
+				pixel[2] = (unsigned char)color.r;
+			}
+		}
+	}
+}
@@ -0,0 +1,104 @@
+#ifndef VOLUMERENDERER_HPP
+#define VOLUMERENDERER_HPP
+
+// Ray casting modes
+enum VolumeMode {
+	VOLUME_DVR,		// Front-to-back compositing with the transfer function
+	VOLUME_MIP,		// Maximum intensity projection
+	VOLUME_ISO		// First hit of the isosurface, Phong shaded
+};
+
+// CPU ray caster over the raw volume, so an image is available without
+// extracting a mesh first.
+// Rays are cast in 2x2 packets (one SSE lane per ray), image tiles run
+// as tasks of the global taskScheduler. Bricks of BRICK_SIZE^3 voxels store their
+// value range, and bricks that cannot contribute are stepped over.
+class volumeRenderer {
+public:
+	void init(const int width, const int height);
+
+	// Volume with x fastest, as getImageData returns it. The vector is
+	// not copied and has to stay alive while rendering.
+	void setVolume(
+		const std::vector<uint8_t> & raw,
+		const unsigned int dimX,
+		const unsigned int dimY,
+		const unsigned int dimZ
+	);
+
+	// Tissue colors (see buildTransferFunction) and opacities per voxel
+	// of ray length (see buildOpacityFunction) for VOLUME_DVR
+	void setTransferFunction(const std::vector<unsigned char> & rgb, const std::vector<float> & opacity);
+
+	// Surface of VOLUME_ISO, as the iso of dcmToModel
+	void setIso(const uint8_t iso);
+
+	// Point lights in world space with power as in fShader (VOLUME_ISO)
+	void setLights(const std::vector<glm::vec3> & positions, const std::vector<float> & powers);
+
+	// Render one frame into BGR rows, bottom-up and padded to 4 bytes
+	// (the layout saveBMP writes). ModelMatrix maps voxel coordinates
+	// to world space.
+	void render(
+		const VolumeMode mode,
+		const glm::mat4 & ProjectionMatrix,
+		const glm::mat4 & ViewMatrix,
+		const glm::mat4 & ModelMatrix,
+		std::vector<unsigned char> & image
+	);
+
+	static const int TILE_SIZE = 32;
+	static const int BRICK_SIZE = 8;
+	// Distance between samples along a ray, in voxels
+	static const float SAMPLE_STEP;
+
+private:
+	// Value range of the voxels a brick's samples interpolate from
+	struct Brick {
+		uint8_t minValue;
+		uint8_t maxValue;
+	};
+
+	void renderTile(const int tileX, const int tileY, std::vector<unsigned char> & image) const;
+
+	// Advance t over bricks that cannot change the result of a ray
+	// (mipMax is the ray's current maximum in VOLUME_MIP)
+	float skipEmptyBricks(
+		const glm::vec3 & origin,
+		const glm::vec3 & direction,
+		float t,
+		const float tEnd,
+		const float mipMax
+	) const;
+
+	// Trilinear sample at a position inside [0, dim - 1]
+	float sample(const glm::vec3 & p) const;
+
+	int width = 0;
+	int height = 0;
+
+	const std::vector<uint8_t> * raw = nullptr;
+	int dims[3] = { 0, 0, 0 };
+	int bricks[3] = { 0, 0, 0 };
+	std::vector<Brick> brickRanges;
+
+	uint8_t iso = 128;
+	std::vector<glm::vec3> transfer;
+	std::vector<float> opacity;
+	std::vector<glm::vec3> lightPositions;
+	std::vector<float> lightPowers;
+
+	// Per frame state
+	VolumeMode mode = VOLUME_DVR;
+	glm::mat4 InverseMVP;
+	glm::mat4 MV;
+	glm::mat3 NormalMatrix;
+	std::vector<glm::vec3> lightsCamera;
+	// Opacity of one SAMPLE_STEP and premultiplied color per value
+	std::vector<float> stepAlpha;
+	std::vector<glm::vec3> stepColor;
+	// Bricks a DVR or ISO ray can step over
+	std::vector<uint8_t> brickEmpty;
+};
+
+#endif // VOLUMERENDERER_HPP
@@ -0,0 +1,147 @@
+// Include standard liabraries
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+// Dual mc vertices and quads
+#include "dualmc.h"
+
+#include "taskScheduler.hpp"
+#include "weldVertices.hpp"
+
+// Quantization steps per voxel
+static const double WELD_STEPS = 1024.0;
+// Bits per axis of the position keys
+static const int WELD_BITS = 21;
+// Vertices or quads per task, and the length of the first sorted runs
+static const int WELD_GRAIN = 65536;
+
+// Vertex and the key of its quantized position
+struct WeldEntry {
+	uint64_t key;
+	int32_t vertex;
+
+	bool operator<(const WeldEntry & other) const {
+		return key < other.key || (key == other.key && vertex < other.vertex);
+	}
+};
+
+// Run body(chunk, begin, end) for every WELD_GRAIN items of count as
+// tasks. Chunks are numbered with int, the items are not, so counts
+// close to INT_MAX do not overflow.
+static void forChunks(const size_t count, const std::function<void(int, size_t, size_t)> & body) {
+	int chunks = (int)((count + WELD_GRAIN - 1) / WELD_GRAIN);
+	taskScheduler::global().parallelFor(0, chunks, 1, [&](int first, int last) {
+		for (int chunk = first; chunk < last; chunk++) {
+			size_t begin = size_t(chunk) * WELD_GRAIN;
+			body(chunk, begin, std::min(begin + WELD_GRAIN, count));
+		}
+	});
+}
+
+void weldVertices(
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors
+) {
+	taskScheduler & scheduler = taskScheduler::global();
+	size_t count = vertices.size();
+	if (count == 0) {
+		return;
+	}
+	int chunks = (int)((count + WELD_GRAIN - 1) / WELD_GRAIN);
+
+	// Largest coordinate, the keys must fit WELD_BITS per axis
+	std::vector<float> chunkLargest(chunks, 0.0f);
+	forChunks(count, [&](int chunk, size_t begin, size_t end) {
+		float largest = 0.0f;
+		for (size_t i = begin; i < end; i++) {
+			largest = std::max(largest, std::max(vertices[i].x, std::max(vertices[i].y, vertices[i].z)));
+		}
+		chunkLargest[chunk] = largest;
+	});
+	double largest = *std::max_element(chunkLargest.begin(), chunkLargest.end());
+	double limit = double((1 << WELD_BITS) - 1);
+	double scale = std::min(WELD_STEPS, limit / (largest + 1.0));
+
+	// Keys, z slowest, and sorted runs of WELD_GRAIN
+	std::vector<WeldEntry> entries(count);
+	forChunks(count, [&](int, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			uint64_t x = (uint64_t)(std::max((double)vertices[i].x, 0.0) * scale + 0.5);
+			uint64_t y = (uint64_t)(std::max((double)vertices[i].y, 0.0) * scale + 0.5);
+			uint64_t z = (uint64_t)(std::max((double)vertices[i].z, 0.0) * scale + 0.5);
+			entries[i].key = x | y << WELD_BITS | z << (2 * WELD_BITS);
+			entries[i].vertex = (int32_t)i;
+		}
+		std::sort(entries.begin() + begin, entries.begin() + end);
+	});
+
+	// Merge the runs pairwise until one is left
+	std::vector<WeldEntry> merged(count);
+	for (size_t run = WELD_GRAIN; run < count; run *= 2) {
+		int pairs = (int)((count + 2 * run - 1) / (2 * run));
+		scheduler.parallelFor(0, pairs, 1, [&](int begin, int end) {
+			for (int pair = begin; pair < end; pair++) {
+				size_t first = 2 * run * pair;
+				size_t middle = std::min(first + run, count);
+				size_t last = std::min(first + 2 * run, count);
+				std::merge(
+					entries.begin() + first, entries.begin() + middle,
+					entries.begin() + middle, entries.begin() + last,
+					merged.begin() + first
+				);
+			}
+		});
+		entries.swap(merged);
+	}
+
+	// Distinct positions per chunk of the sorted entries, then the index
+	// of the first in every chunk
+	std::vector<int32_t> chunkStarts(chunks + 1, 0);
+	forChunks(count, [&](int chunk, size_t begin, size_t end) {
+		int32_t distinct = 0;
+		for (size_t i = begin; i < end; i++) {
+			if (i == 0 || entries[i].key != entries[i - 1].key) {
+				distinct++;
+			}
+		}
+		chunkStarts[chunk + 1] = distinct;
+	});
+	for (int chunk = 0; chunk < chunks; chunk++) {
+		chunkStarts[chunk + 1] += chunkStarts[chunk];
+	}
+
+	// Welded vertices, the first of every position
+	std::vector<int32_t> remap(count);
+	std::vector<dualmc::Vertex> welded(chunkStarts[chunks]);
+	std::vector<uint8_t> weldedColors(chunkStarts[chunks]);
+	forChunks(count, [&](int chunk, size_t begin, size_t end) {
+		int32_t index = chunkStarts[chunk] - 1;
+		for (size_t i = begin; i < end; i++) {
+			int32_t vertex = entries[i].vertex;
+			if (i == 0 || entries[i].key != entries[i - 1].key) {
+				index++;
+				welded[index] = vertices[vertex];
+				weldedColors[index] = colors[vertex];
+			}
+			remap[vertex] = index;
+		}
+	});
+
+	forChunks(quads.size(), [&](int, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			dualmc::Quad & quad = quads[i];
+			quad = dualmc::Quad(remap[quad.i0], remap[quad.i1], remap[quad.i2], remap[quad.i3]);
+		}
+	});
+	vertices.swap(welded);
+	colors.swap(weldedColors);
+}
@@ -0,0 +1,18 @@
+#ifndef WELDVERTICES_HPP
+#define WELDVERTICES_HPP
+
+// Turn a quad soup into a mesh with shared vertices: vertices at the same
+// position, quantized to 1 / WELD_STEPS of a voxel or coarser for very
+// large volumes, become one (the first of them, with its color).
+// Runs in parallel on the global taskScheduler: quantize, sort by
+// position, number the distinct positions, remap the quads. The welded
+// vertices are in the order of their positions, z slowest.
+// The quads index at most INT_MAX vertices (int32_t), see
+// dcmToModel::checkIndexRange.
+void weldVertices(
+	std::vector<dualmc::Vertex> & vertices,
+	std::vector<dualmc::Quad> & quads,
+	std::vector<uint8_t> & colors
+);
+
+#endif // WELDVERTICES_HPP